@@ -2,69 +2,148 @@
 
 #include "agent.h"
 
-Agent::Agent(Agent::SP other)
+// State rules, shared by Agent and AgentLanes
+
+static Numeric clampSize(const Numeric &next)
 {
-    size(other->size());
-    position(other->position());
-    colour(other->colour());
-    velocity(other->velocity());
-    angular_vel(other->angular_vel());
+    const auto &config = getConfig();
+    return std::max(config.MIN_SIZE, std::min(config.MAX_SIZE, next));
 }
 
-void Agent::size(Numeric next)
+static Numeric clampVelocity(const Numeric &next)
 {
     const auto &config = getConfig();
-    m_size = std::max(config.MIN_SIZE, std::min(config.MAX_SIZE, next));
+    auto velocity = next;
+    if (velocity < -config.MAX_VELOCITY)
+    {
+        velocity = -config.MAX_VELOCITY;
+    }
+    if (velocity > config.MAX_VELOCITY)
+    {
+        velocity = config.MAX_VELOCITY;
+    }
+    return velocity;
 }
 
-void Agent::velocity(const Numeric &next)
+static Numeric clampAngularVelocity(const Numeric &next)
 {
     const auto &config = getConfig();
-    m_velocity = next;
-    if (m_velocity < -config.MAX_VELOCITY)
+    auto angular_vel = next;
+    if (angular_vel < -config.MAX_ANGULAR_VELOCITY)
     {
-        m_velocity = -config.MAX_VELOCITY;
+        angular_vel = -config.MAX_ANGULAR_VELOCITY;
     }
-    if (m_velocity > config.MAX_VELOCITY)
+    if (angular_vel > config.MAX_ANGULAR_VELOCITY)
     {
-        m_velocity = config.MAX_VELOCITY;
+        angular_vel = config.MAX_ANGULAR_VELOCITY;
     }
+    return angular_vel;
+}
+
+static void moveBy(Numeric &x, Numeric &y, const Numeric &direction, const int &delta)
+{
+    x += delta * std::sin(direction);
+    y += delta * std::cos(direction);
+}
+
+// Population store
+
+void PopulationStore::resize(const size_t &n)
+{
+    age.resize(n);
+    size.resize(n);
+    velocity.resize(n);
+    x.resize(n);
+    y.resize(n);
+    colour.resize(n);
+    angular_vel.resize(n);
+    direction.resize(n);
+}
+
+// Agent
+
+void Agent::size(Numeric next)
+{
+    size() = clampSize(next);
+}
+
+void Agent::velocity(const Numeric &next)
+{
+    velocity() = clampVelocity(next);
 }
 
 void Agent::position(const Position &next)
 {
-    m_pos.x = next.x;
-    m_pos.y = next.y;
+    m_store->x[m_index] = next.x;
+    m_store->y[m_index] = next.y;
 }
 
 void Agent::move(int delta)
 {
-    m_pos.x += delta * std::sin(m_direction);
-    m_pos.y += delta * std::cos(m_direction);
+    moveBy(m_store->x[m_index], m_store->y[m_index], direction(), delta);
 }
 
 void Agent::colour(const Colour &next)
 {
-    m_col.r = next.r;
-    m_col.g = next.g;
-    m_col.b = next.b;
+    colour() = next;
 }
 
 void Agent::angular_vel(const Numeric &next)
 {
-    const auto &config = getConfig();
-    m_angular_vel = next;
-    if (m_angular_vel < -config.MAX_ANGULAR_VELOCITY)
-    {
-        m_angular_vel = -config.MAX_ANGULAR_VELOCITY;
-    }
-    if (m_angular_vel > config.MAX_ANGULAR_VELOCITY)
-    {
-        m_angular_vel = config.MAX_ANGULAR_VELOCITY;
-    }
+    angular_vel() = clampAngularVelocity(next);
 }
 
 void Agent::direction(const Numeric &next)
 {
-    m_direction = std::fmod(next, TWOPI);
-}
\ No newline at end of file
+    direction() = std::fmod(next, TWOPI);
+}
+
+// Agent lanes
+
+void AgentLanes::load(const size_t &lane, Agent &a)
+{
+    m_size[lane] = a.size();
+    m_velocity[lane] = a.velocity();
+    m_x[lane] = a.position().x;
+    m_y[lane] = a.position().y;
+    m_red[lane] = a.colour().r;
+    m_green[lane] = a.colour().g;
+    m_blue[lane] = a.colour().b;
+    m_angular_vel[lane] = a.angular_vel();
+    m_direction[lane] = a.direction();
+}
+
+void AgentLanes::store(const size_t &lane, Agent &a) const
+{
+    a.size(m_size[lane]);
+    a.velocity(m_velocity[lane]);
+    a.position({m_x[lane], m_y[lane]});
+    a.colour({m_red[lane], m_green[lane], m_blue[lane]});
+    a.angular_vel(m_angular_vel[lane]);
+    a.direction(m_direction[lane]);
+}
+
+void AgentLanes::size(const size_t &l, Numeric next)
+{
+    m_size[l] = clampSize(next);
+}
+
+void AgentLanes::velocity(const size_t &l, const Numeric &next)
+{
+    m_velocity[l] = clampVelocity(next);
+}
+
+void AgentLanes::move(const size_t &l, int delta)
+{
+    moveBy(m_x[l], m_y[l], m_direction[l], delta);
+}
+
+void AgentLanes::angular_vel(const size_t &l, const Numeric &next)
+{
+    m_angular_vel[l] = clampAngularVelocity(next);
+}
+
+void AgentLanes::direction(const size_t &l, const Numeric &next)
+{
+    m_direction[l] = std::fmod(next, TWOPI);
+}
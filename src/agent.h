@@ -1,7 +1,8 @@
 #pragma once
 
+#include <array>
 #include <inttypes.h>
-#include <memory>
+#include <vector>
 
 #include "config.h"
 
@@ -18,42 +19,90 @@ struct Colour
     uint8_t b;
 };
 
-class Agent : public std::enable_shared_from_this<Agent>
+// Fields of an agent's state, as bits of AgentFields; used to work out
+// which sinks can affect the error function
+enum AgentField : uint16_t
 {
-public:
-    using SP = std::shared_ptr<Agent>;
+    FIELD_AGE = 1 << 0,
+    FIELD_SIZE = 1 << 1,
+    FIELD_VELOCITY = 1 << 2,
+    FIELD_POSITION = 1 << 3,
+    FIELD_COLOUR_R = 1 << 4,
+    FIELD_COLOUR_G = 1 << 5,
+    FIELD_COLOUR_B = 1 << 6,
+    FIELD_ANGULAR_VELOCITY = 1 << 7,
+    FIELD_DIRECTION = 1 << 8,
+};
+
+using AgentFields = uint16_t;
+
+// Population Store
+//
+// The state of every agent of a population, field by field in contiguous
+// arrays; agent i is slot i of every array.
+
+struct PopulationStore
+{
+    std::vector<size_t> age;
+    std::vector<Numeric> size;
+
+    std::vector<Numeric> velocity;
+    std::vector<Numeric> x;
+    std::vector<Numeric> y;
+
+    std::vector<Colour> colour;
 
-    Agent() {}
+    std::vector<Numeric> angular_vel;
+    std::vector<Numeric> direction;
+
+    size_t count() const
+    {
+        return x.size();
+    }
+
+    void resize(const size_t &n);
+};
+
+// An agent is a view onto its slot of a population store; the setters
+// keep the state within the configured bounds
+
+class Agent
+{
+public:
+    Agent(PopulationStore &store, const size_t &index) : m_store(&store), m_index(index) {}
 
-    Agent(Agent::SP other);
+    size_t index() const
+    {
+        return m_index;
+    }
 
     size_t &age()
     {
-        return m_age;
+        return m_store->age[m_index];
     }
 
     void age(const size_t &next)
     {
-        m_age = next;
+        m_store->age[m_index] = next;
     }
 
     Numeric &size()
     {
-        return m_size;
+        return m_store->size[m_index];
     }
 
     void size(Numeric next);
 
     Numeric &velocity()
     {
-        return m_velocity;
+        return m_store->velocity[m_index];
     }
 
     void velocity(const Numeric &next);
 
-    Position &position()
+    Position position() const
     {
-        return m_pos;
+        return {m_store->x[m_index], m_store->y[m_index]};
     }
 
     void position(const Position &next);
@@ -61,34 +110,114 @@ public:
 
     Colour &colour()
     {
-        return m_col;
+        return m_store->colour[m_index];
     }
 
     void colour(const Colour &next);
 
     Numeric &angular_vel()
     {
-        return m_angular_vel;
+        return m_store->angular_vel[m_index];
     }
 
     void angular_vel(const Numeric &next);
 
     Numeric &direction()
     {
-        return m_direction;
+        return m_store->direction[m_index];
     }
 
     void direction(const Numeric &next);
 
 private:
-    size_t m_age;
-    Numeric m_size;
+    PopulationStore *m_store;
+    size_t m_index;
+};
+
+// Agent state of a lane group, field by field with one lane per agent, so
+// that a tick can run across the lanes; the setters follow Agent's rules
+class AgentLanes
+{
+public:
+    void load(const size_t &lane, Agent &a);
+    void store(const size_t &lane, Agent &a) const;
+
+    const Numeric &size(const size_t &l) const
+    {
+        return m_size[l];
+    }
+
+    void size(const size_t &l, Numeric next);
+
+    const Numeric &velocity(const size_t &l) const
+    {
+        return m_velocity[l];
+    }
+
+    void velocity(const size_t &l, const Numeric &next);
+
+    Position position(const size_t &l) const
+    {
+        return {m_x[l], m_y[l]};
+    }
+
+    void move(const size_t &l, int delta);
+
+    uint8_t &red(const size_t &l)
+    {
+        return m_red[l];
+    }
+
+    const uint8_t &red(const size_t &l) const
+    {
+        return m_red[l];
+    }
+
+    uint8_t &green(const size_t &l)
+    {
+        return m_green[l];
+    }
+
+    const uint8_t &green(const size_t &l) const
+    {
+        return m_green[l];
+    }
+
+    uint8_t &blue(const size_t &l)
+    {
+        return m_blue[l];
+    }
+
+    const uint8_t &blue(const size_t &l) const
+    {
+        return m_blue[l];
+    }
+
+    const Numeric &angular_vel(const size_t &l) const
+    {
+        return m_angular_vel[l];
+    }
+
+    void angular_vel(const size_t &l, const Numeric &next);
+
+    const Numeric &direction(const size_t &l) const
+    {
+        return m_direction[l];
+    }
+
+    void direction(const size_t &l, const Numeric &next);
+
+private:
+    std::array<Numeric, LANES> m_size{};
+
+    std::array<Numeric, LANES> m_velocity{};
+    std::array<Numeric, LANES> m_x{};
+    std::array<Numeric, LANES> m_y{};
 
-    Numeric m_velocity;
-    Position m_pos;
-    
-    Colour m_col;
+    std::array<uint8_t, LANES> m_red{};
+    std::array<uint8_t, LANES> m_green{};
+    std::array<uint8_t, LANES> m_blue{};
 
-    Numeric m_angular_vel;
-    Numeric m_direction;
+    std::array<Numeric, LANES> m_angular_vel{};
+    std::array<Numeric, LANES> m_direction{};
 };
@@ -0,0 +1,107 @@
+#include "allocations.h"
+
+#ifdef FEATURE_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> allocations{0};
+
+size_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+static void *allocate(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+static void *allocate(std::size_t size, std::align_val_t align)
+{
+    // aligned_alloc takes a multiple of the alignment
+    const auto a = static_cast<std::size_t>(align);
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::aligned_alloc(a, ((size + a - 1) / a) * a))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Replacement operators; everything is released with free
+
+void *operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t align)
+{
+    return allocate(size, align);
+}
+
+void *operator new[](std::size_t size, std::align_val_t align)
+{
+    return allocate(size, align);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+#else
+
+size_t allocationCount()
+{
+    return 0;
+}
+
+#endif // FEATURE_COUNT_ALLOCATIONS
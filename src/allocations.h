@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+// Allocation Counting
+//
+// With FEATURE_COUNT_ALLOCATIONS, the global operator new is replaced with
+// one that counts every heap allocation, on every thread, so that hidden
+// allocations in the tick loop show up; otherwise nothing is counted.
+
+// the number of heap allocations so far; always 0 without the feature
+size_t allocationCount();
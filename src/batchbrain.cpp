@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <utility>
+#include <array>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif // _OPENMP
+
+#include "batchbrain.h"
+#include "kernels.h"
+
+static size_t threadCount()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif // _OPENMP
+}
+
+static size_t threadIndex()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif // _OPENMP
+}
+
+bool BatchBrain::load(std::vector<NeuralAgent> &agents)
+{
+    const auto &config = getConfig();
+    clear();
+
+    // quantized brains are evaluated agent by agent
+    if (!config.NEURAL_COMPILED || !config.NEURAL_BATCHED || config.NEURAL_QUANTIZE_BITS != 0 || agents.empty())
+    {
+        return false;
+    }
+
+    const auto first = &agents[0];
+    for (auto &agent : agents)
+    {
+        const auto a = &agent;
+        if (a->brainType() != NeuralBrainType::LAYERED && a->brainType() != NeuralBrainType::NO_MEMORY)
+        {
+            clear();
+            return false;
+        }
+        if (a->updateType() != NeuralUpdateType::EVERY && a->updateType() != NeuralUpdateType::THRESHOLD)
+        {
+            clear();
+            return false;
+        }
+        // incremental evaluation keeps per-agent state between ticks
+        if (a->updateType() == NeuralUpdateType::THRESHOLD && config.NEURAL_INCREMENTAL)
+        {
+            clear();
+            return false;
+        }
+        if (a->brainType() != first->brainType() || a->updateType() != first->updateType())
+        {
+            clear();
+            return false;
+        }
+
+        m_agents.push_back(a);
+    }
+
+    // compiling lays out each agent's brains, so the brains are listed after
+#pragma omp parallel for
+    for (size_t i = 0; i < m_agents.size(); ++i)
+    {
+        m_agents[i]->compile();
+    }
+    for (const auto a : m_agents)
+    {
+        m_brains.push_back(&a->compiled());
+        if (first->sliceable())
+        {
+            m_slicedBrains.push_back(&a->sliced());
+        }
+    }
+
+    const auto &c = first->compiled();
+    m_numLayers = c.layers.size();
+    m_numSources = c.numSources;
+    m_numNeurons = c.values.size();
+    m_numSlicedNeurons = first->sliceable() ? first->sliced().values.size() : 0;
+    m_updateType = first->updateType();
+
+    m_scratch.resize(threadCount());
+    for (auto &s : m_scratch)
+    {
+        s.resize(BLOCK_SIZE * m_numNeurons);
+    }
+    m_activations.resize(threadCount());
+    for (auto &s : m_activations)
+    {
+        s.resize(c.activations.size());
+    }
+
+    return true;
+}
+
+void BatchBrain::clear()
+{
+    m_agents.clear();
+    m_brains.clear();
+    m_slicedBrains.clear();
+}
+
+void BatchBrain::update(const size_t &iter, const bool &sliced)
+{
+    const size_t numBlocks = (m_agents.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+#pragma omp parallel for
+    for (size_t b = 0; b < numBlocks; ++b)
+    {
+        const auto begin = b * BLOCK_SIZE;
+        const auto end = std::min(begin + BLOCK_SIZE, m_agents.size());
+        const auto t = threadIndex();
+        updateBlock(begin, end, iter, sliced && !m_slicedBrains.empty(), m_scratch[t].data(), m_activations[t].data());
+    }
+}
+
+void BatchBrain::updateBlock(const size_t &begin, const size_t &end, const size_t &iter, const bool &sliced, Numeric *values, Numeric *activations)
+{
+    const auto &config = getConfig();
+    const auto n = end - begin;
+    const auto N = sliced ? m_numSlicedNeurons : m_numNeurons;
+    const auto *brains = sliced ? &m_slicedBrains[begin] : &m_brains[begin];
+
+    std::fill(values, values + (n * N), 0);
+
+    // sense; gather the block's sources
+    for (size_t a = 0; a < n; ++a)
+    {
+        auto agent = m_agents[begin + a];
+        agent->age(iter);
+        agent->sense(&values[a * N]);
+    }
+
+    // think; brains with a kernel specialised for their shape are evaluated
+    // whole, the rest one layer at a time across the block
+    std::array<bool, BLOCK_SIZE> generic;
+    for (size_t a = 0; a < n; ++a)
+    {
+        generic[a] = m_updateType != NeuralUpdateType::EVERY || !brains[a]->update_Specialized(&values[a * N]);
+    }
+
+    for (size_t l = 0; l < m_numLayers; ++l)
+    {
+        if (m_updateType == NeuralUpdateType::THRESHOLD)
+        {
+            for (size_t a = 0; a < n; ++a)
+            {
+                brains[a]->layer_Threshold(l, &values[a * N], config.NEURAL_THRESHOLD, activations);
+            }
+        }
+        else
+        {
+            for (size_t a = 0; a < n; ++a)
+            {
+                if (generic[a])
+                {
+                    brains[a]->layer_Every(l, &values[a * N], activations);
+                }
+            }
+        }
+    }
+
+    // act; sinks follow the sources in each agent's values
+    for (size_t a = 0; a < n; ++a)
+    {
+        m_agents[begin + a]->applySinks(&values[(a * N) + m_numSources], sliced);
+    }
+}
+
+// Lane Brain
+
+bool LaneBrain::load(std::vector<NeuralAgent> &agents)
+{
+    const auto &config = getConfig();
+    clear();
+
+    // quantized brains are evaluated agent by agent
+    if (!config.NEURAL_COMPILED || !config.NEURAL_BATCHED || !config.NEURAL_LANES || config.NEURAL_QUANTIZE_BITS != 0 || agents.empty())
+    {
+        return false;
+    }
+
+    const auto first = &agents[0];
+    if (first->brainType() != NeuralBrainType::LAYERED && first->brainType() != NeuralBrainType::NO_MEMORY)
+    {
+        return false;
+    }
+    if (first->updateType() != NeuralUpdateType::EVERY && first->updateType() != NeuralUpdateType::THRESHOLD)
+    {
+        return false;
+    }
+    // incremental evaluation keeps per-agent state between ticks
+    if (first->updateType() == NeuralUpdateType::THRESHOLD && config.NEURAL_INCREMENTAL)
+    {
+        return false;
+    }
+
+    // every lane runs the shared layout, straight from the agents' genomes;
+    // disabled weights are zero, so sparse layers run dense
+    const auto &topology = first->topology();
+    const auto &c = topology.compiled;
+    if (std::any_of(c.layers.begin(), c.layers.end(), [](const auto &l)
+                    { return l.recurrent; }))
+    {
+        return false;
+    }
+
+    for (auto &agent : agents)
+    {
+        const auto a = &agent;
+        if (a->brainType() != first->brainType() || a->updateType() != first->updateType() || &a->topology() != &topology)
+        {
+            clear();
+            return false;
+        }
+        m_agents.push_back(a);
+    }
+
+    m_layers = c.layers;
+    m_sources = topology.sources;
+    m_sinks = topology.sinks;
+    m_liveSinks.clear();
+    if (topology.sliceable)
+    {
+        m_liveSinks = topology.liveSinks;
+    }
+    m_numSources = c.numSources;
+    m_numNeurons = c.values.size();
+    m_updateType = first->updateType();
+    m_age = first->age();
+
+    // pack the agents into their groups; the lanes past the end of the
+    // population have no weights, and are never stored
+    m_groups.resize((m_agents.size() + LANES - 1) / LANES);
+#pragma omp parallel for
+    for (size_t g = 0; g < m_groups.size(); ++g)
+    {
+        auto &group = m_groups[g];
+        group.count = std::min(LANES, m_agents.size() - (g * LANES));
+        group.agents = AgentLanes();
+        group.weights.assign(c.weights.size() * LANES, 0);
+        group.values.assign(m_numNeurons * LANES, 0);
+        for (size_t l = 0; l < group.count; ++l)
+        {
+            const auto a = m_agents[(g * LANES) + l];
+            group.agents.load(l, *a);
+            const auto &genome = std::as_const(*a);
+            const auto &weights = genome.weights();
+            const auto &enabled = genome.enabled();
+            for (size_t i = 0; i < weights.size(); ++i)
+            {
+                group.weights[(i * LANES) + l] = enabled[i] ? weights[i] : 0;
+            }
+        }
+    }
+
+    size_t maxFrom = 0;
+    for (const auto &l : m_layers)
+    {
+        maxFrom = std::max(maxFrom, l.numFrom);
+    }
+    m_activations.resize(threadCount());
+    for (auto &s : m_activations)
+    {
+        s.resize(maxFrom * LANES);
+    }
+
+    return true;
+}
+
+void LaneBrain::clear()
+{
+    // the groups keep their storage for the next load
+    m_agents.clear();
+    m_stored = true;
+}
+
+void LaneBrain::update(const size_t &iter, const bool &sliced)
+{
+#pragma omp parallel for
+    for (size_t g = 0; g < m_groups.size(); ++g)
+    {
+        updateGroup(m_groups[g], iter, sliced && !m_liveSinks.empty(), m_activations[threadIndex()].data());
+    }
+    m_age = iter;
+    m_stored = false;
+}
+
+void LaneBrain::updateGroup(LaneGroup &g, const size_t &iter, const bool &sliced, Numeric *activations) const
+{
+    const auto &config = getConfig();
+    const auto &k = getKernels();
+    auto *values = g.values.data();
+
+    std::fill(g.values.begin(), g.values.end(), 0);
+
+    // sense, a source at a time across the lanes
+    for (size_t i = 0; i < m_sources.size(); ++i)
+    {
+        senseSource(m_sources[i], g.agents, iter, &values[i * LANES]);
+    }
+
+    // think; every row of a layer is one weight per lane for each "to"
+    // neuron, so it accumulates across the lanes at once
+    for (const auto &l : m_layers)
+    {
+        const auto *in = &values[l.from * LANES];
+        if (l.from >= m_numSources)
+        {
+            k.sigmoid(in, activations, l.numFrom * LANES);
+            in = activations;
+        }
+
+        auto *out = &values[l.to * LANES];
+        for (size_t i = 0; i < l.numFrom; ++i)
+        {
+            const auto *row = &g.weights[(l.weights + (i * l.numTo)) * LANES];
+            if (m_updateType == NeuralUpdateType::THRESHOLD)
+            {
+                k.laneThreshold(&in[i * LANES], row, out, l.numTo, config.NEURAL_THRESHOLD);
+            }
+            else
+            {
+                k.laneAccumulate(&in[i * LANES], row, out, l.numTo);
+            }
+        }
+    }
+
+    // act, a sink at a time across the lanes; sinks follow the sources
+    auto *sinks = &values[m_numSources * LANES];
+    k.sigmoid(sinks, sinks, m_sinks.size() * LANES);
+    for (size_t j = 0; j < m_sinks.size(); ++j)
+    {
+        if (!sliced || m_liveSinks[j])
+        {
+            applySink(m_sinks[j], g.agents, &sinks[j * LANES]);
+        }
+    }
+}
+
+void LaneBrain::store()
+{
+    if (m_stored)
+    {
+        return;
+    }
+
+#pragma omp parallel for
+    for (size_t g = 0; g < m_groups.size(); ++g)
+    {
+        const auto &group = m_groups[g];
+        for (size_t l = 0; l < group.count; ++l)
+        {
+            const auto a = m_agents[(g * LANES) + l];
+            group.agents.store(l, *a);
+            a->age(m_age);
+        }
+    }
+    m_stored = true;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+
+#include "agent.h"
+#include "brain.h"
+#include "neuralagent.h"
+
+// Batch Brain
+//
+// Evaluates a whole population of compiled NeuralAgents sharing the same
+// brain topology. Agents are processed in blocks: the block's sources are
+// gathered into an agents x neurons matrix, then each layer is evaluated
+// across the whole block before moving to the next, keeping the block's
+// activations in cache.
+
+class BatchBrain
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    // returns false if the population cannot be batch evaluated
+    bool load(std::vector<NeuralAgent> &agents);
+    void clear();
+
+    bool loaded() const
+    {
+        return !m_agents.empty();
+    }
+
+    // sliced as for NeuralAgent::update
+    void update(const size_t &iter, const bool &sliced);
+
+private:
+    void updateBlock(const size_t &begin, const size_t &end, const size_t &iter, const bool &sliced, Numeric *values, Numeric *activations);
+
+private:
+    std::vector<NeuralAgent *> m_agents;
+    std::vector<const CompiledBrain *> m_brains;
+    std::vector<const CompiledBrain *> m_slicedBrains; // empty if not sliceable
+    size_t m_numLayers = 0;
+    size_t m_numSources = 0;
+    size_t m_numNeurons = 0;
+    size_t m_numSlicedNeurons = 0;
+    NeuralUpdateType m_updateType = NeuralUpdateType::EVERY;
+
+    // one block of neuron values, and one layer of activations, per thread
+    std::vector<std::vector<Numeric>> m_scratch;
+    std::vector<std::vector<Numeric>> m_activations;
+};
+
+// Lane Brain
+//
+// Evaluates a population like BatchBrain, but in lane groups of LANES
+// agents whose state, weights and neuron values are interleaved lane by
+// lane, so that each step of a sense, think, act tick runs across a whole
+// group at once in vector registers. While loaded, the groups hold the
+// agents' state; store() writes it back to the agents before they are
+// drawn or selected.
+
+class LaneBrain
+{
+public:
+    // returns false if the population cannot be evaluated in lane groups
+    bool load(std::vector<NeuralAgent> &agents);
+    void clear();
+
+    bool loaded() const
+    {
+        return !m_agents.empty();
+    }
+
+    // sliced as for NeuralAgent::update
+    void update(const size_t &iter, const bool &sliced);
+
+    // write the agent state back to the agents, if it changed since
+    void store();
+
+private:
+    struct LaneGroup
+    {
+        size_t count = 0;
+        AgentLanes agents;
+
+        // weight or neuron value i of lane l is at (i * LANES) + l
+        std::vector<Numeric> weights;
+        std::vector<Numeric> values;
+    };
+
+    void updateGroup(LaneGroup &g, const size_t &iter, const bool &sliced, Numeric *activations) const;
+
+private:
+    std::vector<NeuralAgent *> m_agents;
+    std::vector<LaneGroup> m_groups;
+    std::vector<BrainLayer> m_layers;
+    std::vector<SourceKind> m_sources;
+    std::vector<SinkKind> m_sinks;
+    std::vector<uint8_t> m_liveSinks; // empty if not sliceable
+    size_t m_numSources = 0;
+    size_t m_numNeurons = 0;
+    NeuralUpdateType m_updateType = NeuralUpdateType::EVERY;
+    size_t m_age = 0;
+    bool m_stored = true;
+
+    // one layer of activations per thread
+    std::vector<std::vector<Numeric>> m_activations;
+};
@@ -0,0 +1,769 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "brain.h"
+#include "kernels.h"
+#include "neuron.h"
+
+void CompiledBrain::clear(const size_t &sources, const size_t &sinks, const size_t &memory)
+{
+    numSources = sources;
+    numSinks = sinks;
+    numMemory = memory;
+
+    layers.clear();
+    sparse.clear();
+    specialized = nullptr;
+    dense = true;
+    weights.clear();
+    values.clear();
+    values.resize(numSources + numSinks + numMemory);
+    activations.clear();
+    activations.resize(numSinks);
+    primed = false;
+
+    quantizeBits = 0;
+    quantized.clear();
+    weights8.clear();
+    weights16.clear();
+}
+
+void CompiledBrain::addLayer(const size_t &from, const size_t &numFrom, const size_t &to, const size_t &numTo)
+{
+    const size_t offset = layers.empty() ? 0 : layers.back().weights + (layers.back().numFrom * layers.back().numTo);
+    layers.push_back({from, numFrom, to, numTo, offset, from == to});
+    sparse.emplace_back();
+    weights.resize(offset + (numFrom * numTo));
+    activations.resize(std::max(activations.size(), numFrom));
+}
+
+void CompiledBrain::reset()
+{
+    std::fill(values.begin(), values.end(), 0);
+}
+
+void CompiledBrain::slice(const CompiledBrain &full, const std::vector<uint8_t> &liveSinks)
+{
+    clear(full.numSources, std::count(liveSinks.begin(), liveSinks.end(), 1), full.numMemory);
+
+    // index in full to index here; a dead sink maps to the next live one
+    const auto remap = [&](const size_t &i) -> size_t
+    {
+        if (i < full.sinkIndex(0))
+        {
+            return i;
+        }
+        if (i < full.memoryIndex(0))
+        {
+            return sinkIndex(std::count(liveSinks.begin(), liveSinks.begin() + (i - full.sinkIndex(0)), 1));
+        }
+        return memoryIndex(i - full.memoryIndex(0));
+    };
+
+    for (const auto &l : full.layers)
+    {
+        const auto from = remap(l.from);
+        const auto to = remap(l.to);
+        addLayer(from, remap(l.from + l.numFrom) - from, to, remap(l.to + l.numTo) - to);
+    }
+    specialized = full.specialized;
+}
+
+void CompiledBrain::compileSparse(const uint8_t *enabled, const Numeric &density)
+{
+    dense = true;
+    for (size_t li = 0; li < layers.size(); ++li)
+    {
+        const auto &l = layers[li];
+        auto &s = sparse[li];
+        s.rows.clear();
+        s.columns.clear();
+        s.weights.clear();
+
+        const auto total = l.numFrom * l.numTo;
+        const auto count = std::count(enabled + l.weights, enabled + l.weights + total, 1);
+        if (total == 0 || count >= density * total)
+        {
+            continue;
+        }
+
+        // room for the whole layer, so that recompiling a brain as it is
+        // mutated allocates at most once per layer
+        dense = false;
+        s.rows.reserve(l.numFrom + 1);
+        s.columns.reserve(total);
+        s.weights.reserve(total);
+        s.rows.push_back(0);
+        for (size_t i = 0; i < l.numFrom; ++i)
+        {
+            for (size_t j = 0; j < l.numTo; ++j)
+            {
+                const auto w = l.weights + (i * l.numTo) + j;
+                if (enabled[w])
+                {
+                    s.columns.push_back(j);
+                    s.weights.push_back(weights[w]);
+                }
+            }
+            s.rows.push_back(s.columns.size());
+        }
+    }
+}
+
+bool CompiledBrain::update_Specialized(Numeric *values) const
+{
+    if (specialized == nullptr || !dense)
+    {
+        return false;
+    }
+    specialized(weights.data(), values, numSources, numSinks);
+    return true;
+}
+
+void CompiledBrain::layer_Every(const size_t &i, Numeric *values, Numeric *activations) const
+{
+    if (sparse[i].rows.empty())
+    {
+        Layer_Every(layers[i], weights.data(), values, numSources, activations);
+    }
+    else
+    {
+        Layer_EverySparse(layers[i], sparse[i], values, numSources, activations);
+    }
+}
+
+void CompiledBrain::layer_Threshold(const size_t &i, Numeric *values, const Numeric &threshold, Numeric *activations) const
+{
+    if (sparse[i].rows.empty())
+    {
+        Layer_Threshold(layers[i], weights.data(), values, numSources, threshold, activations);
+    }
+    else
+    {
+        Layer_ThresholdSparse(layers[i], sparse[i], values, numSources, threshold, activations);
+    }
+}
+
+static inline Numeric readNeuron(const Numeric *values, const size_t &i, const size_t &numSources)
+{
+    // sources hold raw sensor values, everything else is a summing sigmoid
+    return i < numSources ? values[i] : sigmoid(values[i]);
+}
+
+// activate every "from" neuron of a layer at once
+static inline const Numeric *activateLayer(const BrainLayer &l, const Numeric *values, const size_t &numSources, Numeric *activations)
+{
+    if (l.from < numSources)
+    {
+        return &values[l.from];
+    }
+    getKernels().sigmoid(&values[l.from], activations, l.numFrom);
+    return activations;
+}
+
+// Layer kernels
+
+void Layer_Every(const BrainLayer &l, const Numeric *weights, Numeric *values, const size_t &numSources, Numeric *activations)
+{
+    auto *out = &values[l.to];
+    if (l.recurrent)
+    {
+        for (size_t i = 0; i < l.numFrom; ++i)
+        {
+            const auto src = l.from + i;
+            auto x = readNeuron(values, src, numSources);
+            const auto *row = &weights[l.weights + (i * l.numTo)];
+            for (size_t j = 0; j < l.numTo; ++j)
+            {
+                out[j] += x * row[j];
+                if ((l.to + j) == src)
+                {
+                    x = readNeuron(values, src, numSources);
+                }
+            }
+        }
+        return;
+    }
+
+    const auto &k = getKernels();
+    const auto *in = activateLayer(l, values, numSources, activations);
+    for (size_t i = 0; i < l.numFrom; ++i)
+    {
+        k.accumulate(in[i], &weights[l.weights + (i * l.numTo)], out, l.numTo);
+    }
+}
+
+void Layer_Threshold(const BrainLayer &l, const Numeric *weights, Numeric *values, const size_t &numSources, const Numeric &threshold, Numeric *activations)
+{
+    const auto *in = l.recurrent ? nullptr : activateLayer(l, values, numSources, activations);
+    for (size_t i = 0; i < l.numFrom; ++i)
+    {
+        const auto src = l.from + i;
+        auto x = in ? in[i] : readNeuron(values, src, numSources);
+        const auto *row = &weights[l.weights + (i * l.numTo)];
+        auto *out = &values[l.to];
+        for (size_t j = 0; j < l.numTo; ++j)
+        {
+            const auto val = x * row[j];
+            // activate above threshold
+            if (std::abs(val) > threshold)
+            {
+                out[j] += val;
+                if (l.recurrent && (l.to + j) == src)
+                {
+                    x = readNeuron(values, src, numSources);
+                }
+            }
+        }
+    }
+}
+
+void Layer_EverySparse(const BrainLayer &l, const SparseLayer &s, Numeric *values, const size_t &numSources, Numeric *activations)
+{
+    const auto *in = l.recurrent ? nullptr : activateLayer(l, values, numSources, activations);
+    auto *out = &values[l.to];
+    for (size_t i = 0; i < l.numFrom; ++i)
+    {
+        const auto src = l.from + i;
+        auto x = in ? in[i] : readNeuron(values, src, numSources);
+        for (auto k = s.rows[i]; k < s.rows[i + 1]; ++k)
+        {
+            const auto j = s.columns[k];
+            out[j] += x * s.weights[k];
+            if (l.recurrent && (l.to + j) == src)
+            {
+                x = readNeuron(values, src, numSources);
+            }
+        }
+    }
+}
+
+void Layer_ThresholdSparse(const BrainLayer &l, const SparseLayer &s, Numeric *values, const size_t &numSources, const Numeric &threshold, Numeric *activations)
+{
+    const auto *in = l.recurrent ? nullptr : activateLayer(l, values, numSources, activations);
+    auto *out = &values[l.to];
+    for (size_t i = 0; i < l.numFrom; ++i)
+    {
+        const auto src = l.from + i;
+        auto x = in ? in[i] : readNeuron(values, src, numSources);
+        for (auto k = s.rows[i]; k < s.rows[i + 1]; ++k)
+        {
+            const auto j = s.columns[k];
+            const auto val = x * s.weights[k];
+            // activate above threshold
+            if (std::abs(val) > threshold)
+            {
+                out[j] += val;
+                if (l.recurrent && (l.to + j) == src)
+                {
+                    x = readNeuron(values, src, numSources);
+                }
+            }
+        }
+    }
+}
+
+// Specialised layered kernels
+
+template <size_t L, size_t K>
+static void Layered_Every(const Numeric *weights, Numeric *values, const size_t &numSources, const size_t &numSinks)
+{
+    auto *memory = &values[numSources + numSinks];
+    std::array<Numeric, K> sum{};
+    std::array<Numeric, K> act;
+
+    // sources to the first memory layer
+    for (size_t i = 0; i < numSources; ++i, weights += K)
+    {
+        const auto x = values[i];
+        for (size_t j = 0; j < K; ++j)
+        {
+            sum[j] += x * weights[j];
+        }
+    }
+
+    // each memory layer to the next
+    for (size_t w = 0; w < L; ++w)
+    {
+        for (size_t j = 0; j < K; ++j)
+        {
+            memory[(w * K) + j] = sum[j];
+            act[j] = sigmoid(sum[j]);
+        }
+        if (w + 1 == L)
+        {
+            break;
+        }
+
+        sum = {};
+        for (size_t i = 0; i < K; ++i, weights += K)
+        {
+            for (size_t j = 0; j < K; ++j)
+            {
+                sum[j] += act[i] * weights[j];
+            }
+        }
+    }
+
+    // the last memory layer to the sinks
+    auto *sinks = &values[numSources];
+    for (size_t i = 0; i < K; ++i, weights += numSinks)
+    {
+        for (size_t j = 0; j < numSinks; ++j)
+        {
+            sinks[j] += act[i] * weights[j];
+        }
+    }
+}
+
+template <size_t L>
+static LayeredKernel findLayeredKernelOfWidth(const size_t &width)
+{
+    switch (width)
+    {
+    case 2:
+        return Layered_Every<L, 2>;
+    case 4:
+        return Layered_Every<L, 4>;
+    case 8:
+        return Layered_Every<L, 8>;
+    case 16:
+        return Layered_Every<L, 16>;
+    }
+    return nullptr;
+}
+
+LayeredKernel findLayeredKernel(const size_t &layers, const size_t &width)
+{
+    switch (layers)
+    {
+    case 1:
+        return findLayeredKernelOfWidth<1>(width);
+    case 2:
+        return findLayeredKernelOfWidth<2>(width);
+    case 3:
+        return findLayeredKernelOfWidth<3>(width);
+    case 4:
+        return findLayeredKernelOfWidth<4>(width);
+    }
+    return nullptr;
+}
+
+// Quantized layers
+
+template <typename T>
+static void quantizeLayer(const BrainLayer &l, const QuantizedLayer &q, const Numeric *weights, T *quantized)
+{
+    for (size_t i = 0; i < l.numFrom; ++i)
+    {
+        for (size_t j = 0; j < l.numTo; ++j)
+        {
+            const auto w = weights[l.weights + (i * l.numTo) + j];
+            quantized[q.weights + (j * l.numFrom) + i] = q.scale == 0 ? 0 : static_cast<T>(std::lrint(w / q.scale));
+        }
+    }
+}
+
+bool CompiledBrain::compileQuantized(const int &bits, const CompiledBrain *full)
+{
+    if (std::any_of(layers.begin(), layers.end(), [](const auto &l)
+                    { return l.recurrent; }))
+    {
+        return false;
+    }
+
+    const Numeric weightMax = bits == 8 ? INT8_MAX : INT16_MAX;
+    size_t offset = 0;
+    size_t maxFrom = 0;
+    quantized.clear();
+    for (size_t li = 0; li < layers.size(); ++li)
+    {
+        const auto &l = layers[li];
+        Numeric maxabs = 0;
+        for (size_t w = l.weights; w < l.weights + (l.numFrom * l.numTo); ++w)
+        {
+            maxabs = std::max(maxabs, std::abs(weights[w]));
+        }
+
+        // int8 products cannot overflow a row; int16 inputs are narrowed
+        // to keep each row's sum within 32 bits
+        const Numeric inputMax = bits == 8 ? INT8_MAX : std::min<Numeric>(INT16_MAX, std::floor(INT32_MAX / (weightMax * std::max<size_t>(1, l.numFrom))));
+        const auto scale = (full != nullptr && full->quantizeBits == bits) ? full->quantized[li].scale : maxabs / weightMax;
+        quantized.push_back({offset, scale, inputMax});
+        offset += l.numFrom * l.numTo;
+        maxFrom = std::max(maxFrom, l.numFrom);
+    }
+
+    quantizeBits = bits;
+    weights8.assign(bits == 8 ? offset : 0, 0);
+    weights16.assign(bits == 8 ? 0 : offset, 0);
+    inputs8.assign(bits == 8 ? maxFrom : 0, 0);
+    inputs16.assign(bits == 8 ? 0 : maxFrom, 0);
+    for (size_t li = 0; li < layers.size(); ++li)
+    {
+        if (bits == 8)
+        {
+            quantizeLayer(layers[li], quantized[li], weights.data(), weights8.data());
+        }
+        else
+        {
+            quantizeLayer(layers[li], quantized[li], weights.data(), weights16.data());
+        }
+    }
+
+    // the agent keeps the full precision weights for mutation; the storage
+    // is kept for the next compile
+    weights.clear();
+    for (auto &s : sparse)
+    {
+        s.rows.clear();
+        s.columns.clear();
+        s.weights.clear();
+    }
+    dense = true;
+    return true;
+}
+
+// out[j] += scale * (quantized inputs . quantized row j); the inputs are
+// scaled so that the largest of them is inputMax
+template <typename T>
+static void Layer_Quantized(const BrainLayer &l, const QuantizedLayer &q, const T *weights, T *inputs, int32_t (*dot)(const T *, const T *, const size_t &), Numeric *values, const size_t &numSources, Numeric *activations)
+{
+    const auto *in = activateLayer(l, values, numSources, activations);
+    Numeric maxabs = 0;
+    for (size_t i = 0; i < l.numFrom; ++i)
+    {
+        maxabs = std::max(maxabs, std::abs(in[i]));
+    }
+    if (maxabs == 0 || q.scale == 0)
+    {
+        return;
+    }
+
+    const auto toInput = q.inputMax / maxabs;
+    for (size_t i = 0; i < l.numFrom; ++i)
+    {
+        inputs[i] = static_cast<T>(std::lrint(in[i] * toInput));
+    }
+    const auto scale = q.scale / toInput;
+    auto *out = &values[l.to];
+    for (size_t j = 0; j < l.numTo; ++j)
+    {
+        out[j] += scale * dot(inputs, &weights[q.weights + (j * l.numFrom)], l.numFrom);
+    }
+}
+
+bool CompiledBrain::update_Quantized()
+{
+    if (quantizeBits == 0)
+    {
+        return false;
+    }
+    const auto &k = getKernels();
+    for (size_t li = 0; li < layers.size(); ++li)
+    {
+        if (quantizeBits == 8)
+        {
+            Layer_Quantized(layers[li], quantized[li], weights8.data(), inputs8.data(), k.dot8, values.data(), numSources, activations.data());
+        }
+        else
+        {
+            Layer_Quantized(layers[li], quantized[li], weights16.data(), inputs16.data(), k.dot16, values.data(), numSources, activations.data());
+        }
+    }
+    return true;
+}
+
+// Update strategies
+
+void CompiledBrain::update_Max()
+{
+    evaluateMax(values.data());
+}
+
+void CompiledBrain::evaluateMax(Numeric *values) const
+{
+    // nothing is written until the end, so every read sees the reset state
+    Numeric maxabsval = -1;
+    size_t maxidx = this->values.size();
+    Numeric maxw = 0;
+
+    for (const auto &l : layers)
+    {
+        for (size_t i = 0; i < l.numFrom; ++i)
+        {
+            const auto x = readNeuron(values, l.from + i, numSources);
+            const auto *row = &weights[l.weights + (i * l.numTo)];
+            for (size_t j = 0; j < l.numTo; ++j)
+            {
+                const auto absval = std::abs(x * row[j]);
+                if (absval > maxabsval)
+                {
+                    maxabsval = absval;
+                    maxidx = l.to + j;
+                    maxw = row[j];
+                }
+            }
+        }
+    }
+
+    if (maxidx < this->values.size())
+    {
+        values[maxidx] += maxw;
+    }
+}
+
+void CompiledBrain::update_Threshold(const Numeric &threshold)
+{
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        layer_Threshold(i, values.data(), threshold, activations.data());
+    }
+}
+
+void CompiledBrain::update_Every()
+{
+    if (update_Quantized() || update_Specialized(values.data()))
+    {
+        return;
+    }
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        layer_Every(i, values.data(), activations.data());
+    }
+}
+
+// Incremental update strategies
+
+static std::atomic<size_t> mismatches = 0;
+
+size_t incrementalMismatches()
+{
+    return mismatches;
+}
+
+// Inputs and contributions are compared with ==; a zero of either sign
+// adds nothing to a sum, and a NaN always counts as changed. The check
+// against the full evaluation is bitwise.
+static inline bool same(const Numeric &a, const Numeric &b)
+{
+    return std::memcmp(&a, &b, sizeof(Numeric)) == 0;
+}
+
+bool CompiledBrain::prepareIncremental()
+{
+    if (!dense)
+    {
+        return false;
+    }
+    size_t rows = 0;
+    for (const auto &l : layers)
+    {
+        if (l.recurrent)
+        {
+            return false;
+        }
+        rows += l.numFrom;
+    }
+
+    if (!primed)
+    {
+        // the cached sums assume every neuron is written by one layer only
+        dirty.assign(values.size(), 0);
+        for (const auto &l : layers)
+        {
+            for (size_t j = l.to; j < l.to + l.numTo; ++j)
+            {
+                if (dirty[j]++)
+                {
+                    return false;
+                }
+            }
+        }
+
+        inputs.assign(rows, 0);
+        rowMax.assign(rows, -1);
+        rowArgMax.assign(rows, 0);
+        rowTarget.assign(rows, values.size());
+        contributions.assign(weights.size(), 0);
+        sums.assign(values.size(), 0);
+    }
+    return true;
+}
+
+bool CompiledBrain::update_IncrementalMax()
+{
+    if (!prepareIncremental())
+    {
+        return false;
+    }
+
+    // every read sees the reset state, so only source rows ever change;
+    // the argmax is the first row maximum that no later row exceeds, as
+    // in the full evaluation
+    Numeric maxabsval = -1;
+    size_t maxrow = 0;
+    size_t row = 0;
+    for (const auto &l : layers)
+    {
+        for (size_t i = 0; i < l.numFrom; ++i, ++row)
+        {
+            const auto x = readNeuron(values.data(), l.from + i, numSources);
+            if (primed && x == inputs[row])
+            {
+                if (rowMax[row] > maxabsval)
+                {
+                    maxabsval = rowMax[row];
+                    maxrow = row;
+                }
+                continue;
+            }
+            inputs[row] = x;
+
+            Numeric best = -1;
+            const auto *w = &weights[l.weights + (i * l.numTo)];
+            for (size_t j = 0; j < l.numTo; ++j)
+            {
+                const auto absval = std::abs(x * w[j]);
+                if (absval > best)
+                {
+                    best = absval;
+                    rowArgMax[row] = l.weights + (i * l.numTo) + j;
+                    rowTarget[row] = l.to + j;
+                }
+            }
+            rowMax[row] = best;
+            if (best > maxabsval)
+            {
+                maxabsval = best;
+                maxrow = row;
+            }
+        }
+    }
+    primed = true;
+
+    if (maxabsval >= 0 && rowTarget[maxrow] < values.size())
+    {
+        values[rowTarget[maxrow]] += weights[rowArgMax[maxrow]];
+    }
+    return true;
+}
+
+bool CompiledBrain::update_IncrementalThreshold(const Numeric &threshold)
+{
+    if (!prepareIncremental())
+    {
+        return false;
+    }
+
+    size_t row = 0;
+    for (const auto &l : layers)
+    {
+        const auto *in = activateLayer(l, values.data(), numSources, activations.data());
+        auto *last = &inputs[row];
+        auto *c = &contributions[l.weights];
+        auto *sum = &sums[l.to];
+        auto *changed = &dirty[l.to];
+        row += l.numFrom;
+
+        size_t changedRows = 0;
+        for (size_t i = 0; i < l.numFrom; ++i)
+        {
+            changedRows += in[i] != last[i];
+        }
+
+        // when most rows changed, re-threshold and re-add the whole layer
+        if (!primed || (changedRows * 2) > l.numFrom)
+        {
+            std::copy(in, in + l.numFrom, last);
+            std::fill(sum, sum + l.numTo, 0);
+            for (size_t i = 0; i < l.numFrom; ++i)
+            {
+                const auto *w = &weights[l.weights + (i * l.numTo)];
+                auto *ci = &c[i * l.numTo];
+                for (size_t j = 0; j < l.numTo; ++j)
+                {
+                    const auto val = in[i] * w[j];
+                    ci[j] = std::abs(val) > threshold ? val : 0;
+                    sum[j] += ci[j];
+                }
+            }
+            std::copy(sum, sum + l.numTo, &values[l.to]);
+            continue;
+        }
+
+        // otherwise re-threshold the changed rows only; a contribution that
+        // stays below the threshold on both ticks changes no sum
+        std::fill(changed, changed + l.numTo, 0);
+        for (size_t i = 0; changedRows > 0 && i < l.numFrom; ++i)
+        {
+            if (in[i] == last[i])
+            {
+                continue;
+            }
+            last[i] = in[i];
+
+            const auto *w = &weights[l.weights + (i * l.numTo)];
+            auto *ci = &c[i * l.numTo];
+            for (size_t j = 0; j < l.numTo; ++j)
+            {
+                const auto val = in[i] * w[j];
+                const auto next = std::abs(val) > threshold ? val : 0;
+                if (next != ci[j])
+                {
+                    ci[j] = next;
+                    changed[j] = 1;
+                }
+            }
+        }
+
+        // and re-add the changed sums from zero in row order; adding the
+        // zero contribution of an inactive connection leaves a sum unchanged
+        for (size_t j = 0; j < l.numTo; ++j)
+        {
+            if (changed[j])
+            {
+                sum[j] = 0;
+                for (size_t i = 0; i < l.numFrom; ++i)
+                {
+                    sum[j] += c[(i * l.numTo) + j];
+                }
+            }
+        }
+        std::copy(sum, sum + l.numTo, &values[l.to]);
+    }
+    primed = true;
+    return true;
+}
+
+bool CompiledBrain::verifyIncremental(const bool &max, const Numeric &threshold) const
+{
+    std::vector<Numeric> full(values.size(), 0);
+    std::vector<Numeric> scratch(activations.size());
+    std::copy(values.begin(), values.begin() + numSources, full.begin());
+    if (max)
+    {
+        evaluateMax(full.data());
+    }
+    else
+    {
+        for (size_t i = 0; i < layers.size(); ++i)
+        {
+            layer_Threshold(i, full.data(), threshold, scratch.data());
+        }
+    }
+
+    for (size_t i = numSources; i < values.size(); ++i)
+    {
+        if (!same(full[i], values[i]))
+        {
+            ++mismatches;
+            return false;
+        }
+    }
+    return true;
+}
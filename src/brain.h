@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "config.h"
+
+// Compiled Brain
+//
+// Neurons are addressed by index in a flat value array laid out as
+// [sources | sinks | memory]. Connections are grouped into dense layers,
+// each a row-major (from x to) weight matrix, stored back to back in the
+// same order as the NeuralAgent's connection list. Layers with few enabled
+// connections are also kept in compressed sparse row form.
+
+struct BrainLayer
+{
+    size_t from;
+    size_t numFrom;
+    size_t to;
+    size_t numTo;
+    size_t weights; // offset of the first weight of this layer
+
+    // from and to are the same neurons; evaluate one row at a time so that
+    // reads observe the writes of previous rows
+    bool recurrent;
+};
+
+// Enabled connections of a layer, row by row; rows holds numFrom + 1
+// offsets into columns and weights. Empty rows means the layer is dense.
+struct SparseLayer
+{
+    std::vector<uint32_t> rows;
+    std::vector<uint32_t> columns;
+    std::vector<Numeric> weights;
+};
+
+// Quantized weights of a dense, non-recurrent layer, transposed to one
+// row of numFrom weights per "to" neuron; weight = scale * quantized weight
+struct QuantizedLayer
+{
+    size_t weights; // offset of the first weight of this layer
+    Numeric scale;
+    Numeric inputMax; // largest quantized input whose dot products fit 32 bits
+};
+
+// Layer kernels; values is a single agent's neuron value array and
+// activations is scratch space for at least numFrom values
+
+void Layer_Every(const BrainLayer &l, const Numeric *weights, Numeric *values, const size_t &numSources, Numeric *activations);
+void Layer_Threshold(const BrainLayer &l, const Numeric *weights, Numeric *values, const size_t &numSources, const Numeric &threshold, Numeric *activations);
+void Layer_EverySparse(const BrainLayer &l, const SparseLayer &s, Numeric *values, const size_t &numSources, Numeric *activations);
+void Layer_ThresholdSparse(const BrainLayer &l, const SparseLayer &s, Numeric *values, const size_t &numSources, const Numeric &threshold, Numeric *activations);
+
+// Whole-brain EVERY kernel for a layered brain of a fixed shape, with the
+// memory layers fully unrolled; weights and values as for CompiledBrain
+using LayeredKernel = void (*)(const Numeric *weights, Numeric *values, const size_t &numSources, const size_t &numSinks);
+
+// returns nullptr if there is no kernel specialised for this shape
+LayeredKernel findLayeredKernel(const size_t &layers, const size_t &width);
+
+struct CompiledBrain
+{
+    size_t numSources = 0;
+    size_t numSinks = 0;
+    size_t numMemory = 0;
+
+    std::vector<BrainLayer> layers;
+    std::vector<SparseLayer> sparse;
+    std::vector<Numeric> weights;
+    std::vector<Numeric> values;
+    std::vector<Numeric> activations;
+
+    LayeredKernel specialized = nullptr;
+    bool dense = true;
+
+    // 0, or 8 or 16 when EVERY is evaluated with integer weights; the
+    // floating point weights are then cleared
+    int quantizeBits = 0;
+    std::vector<QuantizedLayer> quantized;
+    std::vector<int8_t> weights8;
+    std::vector<int16_t> weights16;
+    std::vector<int8_t> inputs8;
+    std::vector<int16_t> inputs16;
+
+    // Incremental evaluation state, kept from the previous tick: the
+    // activated inputs and the largest |contribution| of every layer row,
+    // the thresholded contribution of every weight, and the output sum of
+    // every neuron. primed is false until the first full evaluation.
+    std::vector<Numeric> inputs;
+    std::vector<Numeric> rowMax;
+    std::vector<size_t> rowArgMax; // weight index of the row's largest contribution
+    std::vector<size_t> rowTarget; // neuron index of the row's largest contribution
+    std::vector<Numeric> contributions;
+    std::vector<Numeric> sums;
+    std::vector<uint8_t> dirty;
+    bool primed = false;
+
+    size_t sourceIndex(const size_t &i) const
+    {
+        return i;
+    }
+
+    size_t sinkIndex(const size_t &i) const
+    {
+        return numSources + i;
+    }
+
+    size_t memoryIndex(const size_t &i) const
+    {
+        return numSources + numSinks + i;
+    }
+
+    void clear(const size_t &sources, const size_t &sinks, const size_t &memory);
+    void addLayer(const size_t &from, const size_t &numFrom, const size_t &to, const size_t &numTo);
+
+    void reset();
+
+    // lay out this brain as full without the sinks that are not live; the
+    // layers keep their order and rows, less the columns of dead sinks, so
+    // its weights are full's in connection order, less the connections
+    // into dead sinks
+    void slice(const CompiledBrain &full, const std::vector<uint8_t> &liveSinks);
+
+    // build the sparse form of every layer whose fraction of enabled
+    // connections is below density; disabled weights must already be zero
+    void compileSparse(const uint8_t *enabled, const Numeric &density);
+
+    // quantize the weights to bits (8 or 16) and clear the floating point
+    // weights; returns false, and quantizes nothing, if any layer is
+    // recurrent. A sliced brain takes its layer scales from the full one,
+    // so that both quantize alike.
+    bool compileQuantized(const int &bits, const CompiledBrain *full = nullptr);
+
+    // evaluate layer i, dense or sparse, on an agent's value array
+    void layer_Every(const size_t &i, Numeric *values, Numeric *activations) const;
+    void layer_Threshold(const size_t &i, Numeric *values, const Numeric &threshold, Numeric *activations) const;
+
+    // evaluate the EVERY strategy with integer dot products, inputs being
+    // quantized per layer; returns false if the brain is not quantized
+    bool update_Quantized();
+
+    // evaluate the EVERY strategy with the specialised kernel; returns false
+    // if there is none, or if any layer is sparse
+    bool update_Specialized(Numeric *values) const;
+
+    // Update strategies
+
+    void update_Max();
+    void update_Threshold(const Numeric &threshold);
+    void update_Every();
+
+    // Incremental update strategies; only rows whose inputs changed since
+    // the previous tick are re-evaluated, and only the sums of neurons with
+    // a changed contribution are re-added, in the same order as the full
+    // evaluation, so the results are bit-identical to it. Return false if
+    // the brain has recurrent or sparse layers.
+
+    bool update_IncrementalMax();
+    bool update_IncrementalThreshold(const Numeric &threshold);
+
+    // recompute the current tick from the sensed sources alone and compare
+    // the sink and memory sums with the incremental ones
+    bool verifyIncremental(const bool &max, const Numeric &threshold) const;
+
+private:
+    bool prepareIncremental();
+    void evaluateMax(Numeric *values) const;
+};
+
+// number of ticks whose incremental evaluation differed from the full one
+size_t incrementalMismatches();
@@ -10,50 +10,50 @@ const Numeric Error_DistanceTo(const Position &p, const Position &q, const Numer
     return std::sqrt(dx * dx + dy * dy);
 }
 
-const Numeric Error_DistanceToTL(Agent::SP a)
+const Numeric Error_DistanceToTL(Agent &a)
 {
     const auto &config = getConfig();
     return Error_DistanceTo(
-        a->position(),
+        a.position(),
         {0, 0},
         config.SCREEN_WIDTH,
         config.SCREEN_HEIGHT);
 }
 
-const Numeric Error_DistanceToTR(Agent::SP a)
+const Numeric Error_DistanceToTR(Agent &a)
 {
     const auto &config = getConfig();
     return Error_DistanceTo(
-        a->position(),
+        a.position(),
         {static_cast<Numeric>(config.SCREEN_WIDTH), 0},
         config.SCREEN_WIDTH,
         config.SCREEN_HEIGHT);
 }
 
-const Numeric Error_DistanceToBL(Agent::SP a)
+const Numeric Error_DistanceToBL(Agent &a)
 {
     const auto &config = getConfig();
     return Error_DistanceTo(
-        a->position(),
+        a.position(),
         {0, static_cast<Numeric>(config.SCREEN_HEIGHT)},
         config.SCREEN_WIDTH,
         config.SCREEN_HEIGHT);
 }
 
-const Numeric Error_DistanceToBR(Agent::SP a)
+const Numeric Error_DistanceToBR(Agent &a)
 {
     const auto &config = getConfig();
     return Error_DistanceTo(
-        a->position(),
+        a.position(),
         {static_cast<Numeric>(config.SCREEN_WIDTH), static_cast<Numeric>(config.SCREEN_HEIGHT)},
         config.SCREEN_WIDTH,
         config.SCREEN_HEIGHT);
 }
 
-const Numeric Error_DistanceToCentre(Agent::SP a)
+const Numeric Error_DistanceToCentre(Agent &a)
 {
     const auto &config = getConfig();
-    const auto &p = a->position();
+    const auto &p = a.position();
     return Error_DistanceTo(
         p,
         {static_cast<Numeric>(config.SCREEN_WIDTH) / 2,
@@ -62,29 +62,47 @@ const Numeric Error_DistanceToCentre(Agent::SP a)
         config.SCREEN_HEIGHT);
 }
 
-const Numeric Error_Redness(Agent::SP a)
+const Numeric Error_Redness(Agent &a)
 {
-    const auto &r = a->colour().r;
+    const auto &r = a.colour().r;
     return 1.0 - (r / 255.0);
 }
 
-const Numeric Error_Greenness(Agent::SP a)
+const Numeric Error_Greenness(Agent &a)
 {
-    const auto &g = a->colour().g;
+    const auto &g = a.colour().g;
     return 1.0 - (g / 255.0);
 }
 
-const Numeric Error_Blueness(Agent::SP a)
+const Numeric Error_Blueness(Agent &a)
 {
-    const auto &b = a->colour().b;
+    const auto &b = a.colour().b;
     return 1.0 - (b / 255.0);
 }
 
-const Numeric ErrorFunction(Agent::SP a)
+const Numeric ErrorFunction(Agent &a)
 {
     // const auto &config = getConfig();
-    // const auto &p = a->position();
+    // const auto &p = a.position();
     // const auto err = Error_DistanceTo(p, {config.TARGET_X, config.TARGET_Y}, config.SCREEN_WIDTH, config.SCREEN_HEIGHT);
     // return 5.0 * err;
-    return 8.0 * Error_DistanceToTL(a) * Error_DistanceToTR(a);
+    return ErrorFunction(a.position());
+}
+
+const Numeric ErrorFunction(const Position &p)
+{
+    const auto &config = getConfig();
+    const auto tl = Error_DistanceTo(p, {0, 0}, config.SCREEN_WIDTH, config.SCREEN_HEIGHT);
+    const auto tr = Error_DistanceTo(p, {static_cast<Numeric>(config.SCREEN_WIDTH), 0}, config.SCREEN_WIDTH, config.SCREEN_HEIGHT);
+    return 8.0 * tl * tr;
+}
+
+void ErrorFunction(const PopulationStore &store, std::vector<Numeric> &errors)
+{
+    errors.resize(store.count());
+#pragma omp parallel for
+    for (size_t i = 0; i < store.count(); ++i)
+    {
+        errors[i] = ErrorFunction({store.x[i], store.y[i]});
+    }
 }
@@ -5,6 +5,16 @@
 
 #include "agent.h"
 
-using LiveCondition = std::function<const bool(Agent::SP)>;
+using LiveCondition = std::function<const bool(Agent &)>;
 
-const Numeric ErrorFunction(Agent::SP a);
+const Numeric ErrorFunction(Agent &a);
+
+// the same, for agent state held outside an Agent; ERROR_FUNCTION_READS
+// must not go beyond the position
+const Numeric ErrorFunction(const Position &p);
+
+// the error of every agent of a store, slot by slot
+void ErrorFunction(const PopulationStore &store, std::vector<Numeric> &errors);
+
+// the agent state ErrorFunction depends on; keep in step with it
+constexpr AgentFields ERROR_FUNCTION_READS = FIELD_POSITION;
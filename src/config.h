@@ -21,9 +21,16 @@ constexpr auto SDL_PF = SDL_PIXELFORMAT_RGB24;
 constexpr auto SDL_PF = SDL_PIXELFORMAT_RGB24;
 #endif // FEATURE_RENDER_VIDEO
 
+#ifdef FEATURE_SINGLE_PRECISION
+using Numeric = float;
+#else
 using Numeric = double;
+#endif // FEATURE_SINGLE_PRECISION
 constexpr Numeric TWOPI = 2 * 3.14159;
 
+// agents per lane group; a cache line, and an AVX-512 register, of Numeric
+constexpr size_t LANES = 64 / sizeof(Numeric);
+
 enum class NeuralUpdateType
 {
     MAX,
@@ -38,6 +45,14 @@ enum class NeuralBrainType
     FULLY_CONNECTED,
 };
 
+enum class SelectionType
+{
+    THRESHOLD,
+    TOP_K,
+    TOURNAMENT,
+    RANK,
+};
+
 struct Config
 {
     int64_t SEED = 0;
@@ -79,6 +94,18 @@ struct Config
     Numeric NEURAL_THRESHOLD = 0.0; // only for Threshold update strategy
     NeuralUpdateType NEURAL_UPDATE_TYPE = NeuralUpdateType::EVERY;
     NeuralBrainType NEURAL_BRAIN_TYPE = NeuralBrainType::LAYERED;
+    bool NEURAL_COMPILED = true; // evaluate brains as dense weight matrices
+    bool NEURAL_BATCHED = true;  // evaluate compiled brains a population block at a time
+    std::string NEURAL_KERNELS = "auto";
+    bool NEURAL_SPECIALIZED = true; // use unrolled kernels for common layered brain shapes
+    Numeric NEURAL_PRUNE_WEIGHT = 0.0;   // mutation disables connections weaker than this
+    Numeric NEURAL_SPARSE_DENSITY = 0.5; // layers with fewer enabled connections run sparse
+    bool NEURAL_INCREMENTAL = false;        // re-evaluate MAX and THRESHOLD brains from changed sources only
+    bool NEURAL_VERIFY_INCREMENTAL = false; // check incremental evaluation against a full one every tick
+    int NEURAL_QUANTIZE_BITS = 0;           // 8 or 16 to evaluate EVERY brains with integer weights
+    bool NEURAL_SLICED = true;              // skip sinks that cannot affect the error when nothing is drawn
+    bool NEURAL_LANES = true;               // batch agents in SIMD lane groups, state and brains interleaved
+    std::string NEURAL_GENOME_FILE;         // map the genomes from files here, and stream them, if not empty
 
     bool BOUNDED_WEIGHTS = false;
     Numeric MAX_WEIGHT = 0.0;
@@ -91,6 +118,20 @@ struct Config
     size_t MAX_GENS = 0;
     size_t GEN_ITERS = 0;
     size_t REALTIME_EVERY_NGENS = 0;
+    bool BENCHMARK_RANDOM = false; // report random variates per second, then exit
+    size_t BENCHMARK_THREADS = 0;  // report ticks per second at 1, 2, 4... up to this many threads, then exit
+
+    SelectionType SELECTION_TYPE = SelectionType::THRESHOLD; // how the parents of the next generation are picked
+    Numeric SELECTION_FRACTION = 0.1;                       // the share of agents top-k and rank selection keep
+    size_t SELECTION_TOURNAMENT_SIZE = 4;                   // agents drawn per tournament
+
+    size_t ISLANDS = 1;                    // sub-populations evolving apart, each on its own threads
+    size_t ISLAND_MIGRATION_INTERVAL = 10; // generations between migrations from island to island
+    size_t ISLAND_MIGRANTS = 4;            // the best agents an island sends to the next each migration
+
+    std::string COORDINATOR_ADDRESS; // listen here for workers, then evolve with them
+    size_t COORDINATOR_WORKERS = 1;  // workers the coordinator waits for
+    std::string WORKER_ADDRESS;      // connect to the coordinator here, and run its agents
     Numeric MAX_ERROR = 0;
 
 #ifdef FEATURE_RENDER_CHARTS
@@ -102,6 +143,10 @@ struct Config
     Numeric VIDEO_SCALE = 0.0;
 #endif // FEATURE_RENDER_VIDEO
 
+#ifdef FEATURE_COUNT_ALLOCATIONS
+    bool COUNT_ALLOCATIONS = false; // report allocations, and fail if a steady state tick allocates
+#endif // FEATURE_COUNT_ALLOCATIONS
+
 
     Numeric TARGET_X = 720;
     Numeric TARGET_Y = 720;
@@ -0,0 +1,67 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "genome.h"
+
+GenomePool::~GenomePool()
+{
+    release();
+}
+
+bool GenomePool::resize(const size_t &count, const size_t &connections, const std::string &path)
+{
+    release();
+
+    // records keep the next record's weights aligned
+    m_count = count;
+    m_connections = connections;
+    m_stride = connections * (sizeof(Numeric) + 2);
+    m_stride = ((m_stride + sizeof(Numeric) - 1) / sizeof(Numeric)) * sizeof(Numeric);
+    const auto size = count * m_stride;
+
+    if (path.empty())
+    {
+        m_memory.resize(size / sizeof(Numeric));
+        m_data = reinterpret_cast<std::byte *>(m_memory.data());
+        return true;
+    }
+
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+    void *map = MAP_FAILED;
+    if (size > 0 && ftruncate(fd, size) == 0)
+    {
+        map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    // the mapping keeps the file's pages; nothing else needs its name
+    close(fd);
+    unlink(path.c_str());
+    if (map == MAP_FAILED)
+    {
+        m_count = 0;
+        return false;
+    }
+
+    madvise(map, size, MADV_SEQUENTIAL);
+    m_map = map;
+    m_mapSize = size;
+    m_data = static_cast<std::byte *>(map);
+    return true;
+}
+
+void GenomePool::release()
+{
+    if (m_map != nullptr)
+    {
+        munmap(m_map, m_mapSize);
+        m_map = nullptr;
+        m_mapSize = 0;
+    }
+    m_memory.clear();
+    m_memory.shrink_to_fit();
+    m_data = nullptr;
+}
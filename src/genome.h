@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+// Genome Pool
+//
+// The genomes of one generation, back to back in a single block: agent i's
+// record holds its weights, then its mutation directions, then its enable
+// flags, one of each per connection. The block is in memory, or in a file
+// mapped into memory for populations whose genomes do not fit in RAM; a
+// mapped pool is read and written front to back, one record after the
+// other, so that the kernel can page it in ahead of use and out behind.
+
+class GenomePool
+{
+public:
+    GenomePool() = default;
+    GenomePool(const GenomePool &) = delete;
+    GenomePool &operator=(const GenomePool &) = delete;
+    ~GenomePool();
+
+    // room for count genomes of the given number of connections, in memory,
+    // or mapped from a file at path if path is not empty; the file is
+    // removed once mapped. Returns false if the file cannot be mapped.
+    bool resize(const size_t &count, const size_t &connections, const std::string &path);
+
+    size_t count() const
+    {
+        return m_count;
+    }
+
+    size_t connections() const
+    {
+        return m_connections;
+    }
+
+    bool mapped() const
+    {
+        return m_map != nullptr;
+    }
+
+    std::span<Numeric> weights(const size_t &i) const
+    {
+        return {reinterpret_cast<Numeric *>(record(i)), m_connections};
+    }
+
+    std::span<int8_t> deltas(const size_t &i) const
+    {
+        return {reinterpret_cast<int8_t *>(record(i) + (m_connections * sizeof(Numeric))), m_connections};
+    }
+
+    std::span<uint8_t> enabled(const size_t &i) const
+    {
+        return {reinterpret_cast<uint8_t *>(record(i) + (m_connections * (sizeof(Numeric) + 1))), m_connections};
+    }
+
+    // genome i of other over genome to; other has the same connections
+    void copy(const size_t &to, const GenomePool &other, const size_t &i)
+    {
+        std::memcpy(record(to), other.record(i), m_stride);
+    }
+
+private:
+    std::byte *record(const size_t &i) const
+    {
+        return m_data + (i * m_stride);
+    }
+
+    void release();
+
+    size_t m_count = 0;
+    size_t m_connections = 0;
+    size_t m_stride = 0;
+    std::byte *m_data = nullptr;
+
+    // in memory, as Numerics so that the weights are aligned
+    std::vector<Numeric> m_memory;
+
+    // or mapped
+    void *m_map = nullptr;
+    size_t m_mapSize = 0;
+};
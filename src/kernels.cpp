@@ -0,0 +1,648 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#include "kernels.h"
+#include "neuron.h"
+
+// Scalar
+
+static void Scalar_Sigmoid(const Numeric *in, Numeric *out, const size_t &n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = sigmoid(in[i]);
+    }
+}
+
+static void Scalar_Accumulate(const Numeric &x, const Numeric *row, Numeric *out, const size_t &n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] += x * row[i];
+    }
+}
+
+static void Scalar_LaneAccumulate(const Numeric *x, const Numeric *row, Numeric *out, const size_t &n)
+{
+    for (size_t j = 0; j < n * LANES; j += LANES)
+    {
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[j + l] += x[l] * row[j + l];
+        }
+    }
+}
+
+static void Scalar_LaneThreshold(const Numeric *x, const Numeric *row, Numeric *out, const size_t &n, const Numeric &threshold)
+{
+    for (size_t j = 0; j < n * LANES; j += LANES)
+    {
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            const auto val = x[l] * row[j + l];
+            if (std::abs(val) > threshold)
+            {
+                out[j + l] += val;
+            }
+        }
+    }
+}
+
+template <typename T>
+static int32_t Scalar_Dot(const T *x, const T *w, const size_t &n)
+{
+    int32_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        sum += static_cast<int32_t>(x[i]) * w[i];
+    }
+    return sum;
+}
+
+// the Philox4x32 multipliers and key increments
+constexpr uint32_t PHILOX_M0 = 0xd2511f53;
+constexpr uint32_t PHILOX_M1 = 0xcd9e8d57;
+constexpr uint32_t PHILOX_W0 = 0x9e3779b9;
+constexpr uint32_t PHILOX_W1 = 0xbb67ae85;
+constexpr size_t PHILOX_ROUNDS = 10;
+
+static void Scalar_Philox(const uint32_t *counter, const uint32_t *key, uint32_t *out, const size_t &blocks)
+{
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        uint32_t c0 = counter[0] + static_cast<uint32_t>(b);
+        uint32_t c1 = counter[1];
+        uint32_t c2 = counter[2];
+        uint32_t c3 = counter[3];
+        uint32_t k0 = key[0];
+        uint32_t k1 = key[1];
+        for (size_t round = 0; round < PHILOX_ROUNDS; ++round)
+        {
+            const uint64_t p0 = static_cast<uint64_t>(PHILOX_M0) * c0;
+            const uint64_t p1 = static_cast<uint64_t>(PHILOX_M1) * c2;
+            c0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            c1 = static_cast<uint32_t>(p1);
+            c2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            c3 = static_cast<uint32_t>(p0);
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        out[(b * 4) + 0] = c0;
+        out[(b * 4) + 1] = c1;
+        out[(b * 4) + 2] = c2;
+        out[(b * 4) + 3] = c3;
+    }
+}
+
+#ifdef KERNELS_X86
+
+// Vector operations, overloaded on the element type so the kernels below
+// work in both the double and the single precision build
+
+#define AVX2 __attribute__((target("avx2"))) static inline
+#define AVX512 __attribute__((target("avx512f"))) static inline
+
+AVX2 __m256d vload256(const double *p) { return _mm256_loadu_pd(p); }
+AVX2 __m256 vload256(const float *p) { return _mm256_loadu_ps(p); }
+AVX2 void vstore(double *p, const __m256d &v) { _mm256_storeu_pd(p, v); }
+AVX2 void vstore(float *p, const __m256 &v) { _mm256_storeu_ps(p, v); }
+AVX2 __m256d vset256(const double &x) { return _mm256_set1_pd(x); }
+AVX2 __m256 vset256(const float &x) { return _mm256_set1_ps(x); }
+AVX2 __m256d vadd(const __m256d &a, const __m256d &b) { return _mm256_add_pd(a, b); }
+AVX2 __m256 vadd(const __m256 &a, const __m256 &b) { return _mm256_add_ps(a, b); }
+AVX2 __m256d vmul(const __m256d &a, const __m256d &b) { return _mm256_mul_pd(a, b); }
+AVX2 __m256 vmul(const __m256 &a, const __m256 &b) { return _mm256_mul_ps(a, b); }
+AVX2 __m256d vdiv(const __m256d &a, const __m256d &b) { return _mm256_div_pd(a, b); }
+AVX2 __m256 vdiv(const __m256 &a, const __m256 &b) { return _mm256_div_ps(a, b); }
+AVX2 __m256d vsqrt(const __m256d &a) { return _mm256_sqrt_pd(a); }
+AVX2 __m256 vsqrt(const __m256 &a) { return _mm256_sqrt_ps(a); }
+AVX2 __m256d vabs(const __m256d &a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+AVX2 __m256 vabs(const __m256 &a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+// v where a > b, else 0
+AVX2 __m256d vselectgt(const __m256d &a, const __m256d &b, const __m256d &v) { return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ), v); }
+AVX2 __m256 vselectgt(const __m256 &a, const __m256 &b, const __m256 &v) { return _mm256_and_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ), v); }
+
+AVX512 __m512d vload512(const double *p) { return _mm512_loadu_pd(p); }
+AVX512 __m512 vload512(const float *p) { return _mm512_loadu_ps(p); }
+AVX512 void vstore(double *p, const __m512d &v) { _mm512_storeu_pd(p, v); }
+AVX512 void vstore(float *p, const __m512 &v) { _mm512_storeu_ps(p, v); }
+AVX512 __m512d vset512(const double &x) { return _mm512_set1_pd(x); }
+AVX512 __m512 vset512(const float &x) { return _mm512_set1_ps(x); }
+AVX512 __m512d vadd(const __m512d &a, const __m512d &b) { return _mm512_add_pd(a, b); }
+AVX512 __m512 vadd(const __m512 &a, const __m512 &b) { return _mm512_add_ps(a, b); }
+AVX512 __m512d vmul(const __m512d &a, const __m512d &b) { return _mm512_mul_pd(a, b); }
+AVX512 __m512 vmul(const __m512 &a, const __m512 &b) { return _mm512_mul_ps(a, b); }
+AVX512 __m512d vdiv(const __m512d &a, const __m512d &b) { return _mm512_div_pd(a, b); }
+AVX512 __m512 vdiv(const __m512 &a, const __m512 &b) { return _mm512_div_ps(a, b); }
+AVX512 __m512d vsqrt(const __m512d &a) { return _mm512_sqrt_pd(a); }
+AVX512 __m512 vsqrt(const __m512 &a) { return _mm512_sqrt_ps(a); }
+AVX512 __m512d vabs(const __m512d &a) { return _mm512_abs_pd(a); }
+AVX512 __m512 vabs(const __m512 &a) { return _mm512_abs_ps(a); }
+// a + v where |v| > b, else a
+AVX512 __m512d vaddabsgt(const __m512d &a, const __m512d &v, const __m512d &b) { return _mm512_mask_add_pd(a, _mm512_cmp_pd_mask(vabs(v), b, _CMP_GT_OQ), a, v); }
+AVX512 __m512 vaddabsgt(const __m512 &a, const __m512 &v, const __m512 &b) { return _mm512_mask_add_ps(a, _mm512_cmp_ps_mask(vabs(v), b, _CMP_GT_OQ), a, v); }
+
+// AVX2
+
+using AVX2Vector = decltype(vload256(static_cast<const Numeric *>(nullptr)));
+constexpr size_t AVX2_LANES = sizeof(AVX2Vector) / sizeof(Numeric);
+
+__attribute__((target("avx2"))) static void AVX2_Sigmoid(const Numeric *in, Numeric *out, const size_t &n)
+{
+    const auto one = vset256(Numeric(1));
+    size_t i = 0;
+    for (; i + AVX2_LANES <= n; i += AVX2_LANES)
+    {
+        const auto x = vload256(&in[i]);
+        vstore(&out[i], vdiv(x, vsqrt(vadd(one, vmul(x, x)))));
+    }
+    for (; i < n; ++i)
+    {
+        out[i] = sigmoid(in[i]);
+    }
+}
+
+__attribute__((target("avx2"))) static void AVX2_Accumulate(const Numeric &x, const Numeric *row, Numeric *out, const size_t &n)
+{
+    const auto vx = vset256(x);
+    size_t i = 0;
+    for (; i + AVX2_LANES <= n; i += AVX2_LANES)
+    {
+        vstore(&out[i], vadd(vload256(&out[i]), vmul(vx, vload256(&row[i]))));
+    }
+    for (; i < n; ++i)
+    {
+        out[i] += x * row[i];
+    }
+}
+
+// a lane group is two AVX2 vectors
+static_assert(LANES == 2 * AVX2_LANES);
+
+__attribute__((target("avx2"))) static void AVX2_LaneAccumulate(const Numeric *x, const Numeric *row, Numeric *out, const size_t &n)
+{
+    const auto x0 = vload256(&x[0]);
+    const auto x1 = vload256(&x[AVX2_LANES]);
+    for (size_t j = 0; j < n * LANES; j += LANES)
+    {
+        vstore(&out[j], vadd(vload256(&out[j]), vmul(x0, vload256(&row[j]))));
+        vstore(&out[j + AVX2_LANES], vadd(vload256(&out[j + AVX2_LANES]), vmul(x1, vload256(&row[j + AVX2_LANES]))));
+    }
+}
+
+__attribute__((target("avx2"))) static void AVX2_LaneThreshold(const Numeric *x, const Numeric *row, Numeric *out, const size_t &n, const Numeric &threshold)
+{
+    const auto x0 = vload256(&x[0]);
+    const auto x1 = vload256(&x[AVX2_LANES]);
+    const auto t = vset256(threshold);
+    for (size_t j = 0; j < n * LANES; j += LANES)
+    {
+        const auto v0 = vmul(x0, vload256(&row[j]));
+        const auto v1 = vmul(x1, vload256(&row[j + AVX2_LANES]));
+        vstore(&out[j], vadd(vload256(&out[j]), vselectgt(vabs(v0), t, v0)));
+        vstore(&out[j + AVX2_LANES], vadd(vload256(&out[j + AVX2_LANES]), vselectgt(vabs(v1), t, v1)));
+    }
+}
+
+AVX2 int32_t hsum256(const __m256i &v)
+{
+    auto s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+// int8 is widened to int16, so that pairwise products cannot saturate
+__attribute__((target("avx2"))) static int32_t AVX2_Dot8(const int8_t *x, const int8_t *w, const size_t &n)
+{
+    auto acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const auto vx = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&x[i])));
+        const auto vw = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&w[i])));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(vx, vw));
+    }
+    return hsum256(acc) + Scalar_Dot(&x[i], &w[i], n - i);
+}
+
+__attribute__((target("avx2"))) static int32_t AVX2_Dot16(const int16_t *x, const int16_t *w, const size_t &n)
+{
+    auto acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const auto vx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&x[i]));
+        const auto vw = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&w[i]));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(vx, vw));
+    }
+    return hsum256(acc) + Scalar_Dot(&x[i], &w[i], n - i);
+}
+
+// 32 x 32 bit products of each lane of a and m, split in high and low words
+AVX2 void vmulhilo(const __m256i &a, const __m256i &m, __m256i &hi, __m256i &lo)
+{
+    const auto even = _mm256_mul_epu32(a, m);
+    const auto odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+    lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+}
+
+// eight blocks side by side, one per lane, from first, transposed back to
+// block order
+AVX2 void philox8(const uint32_t &first, const uint32_t *counter, const uint32_t *key, uint32_t *out)
+{
+    const auto m0 = _mm256_set1_epi32(PHILOX_M0);
+    const auto m1 = _mm256_set1_epi32(PHILOX_M1);
+    auto c0 = _mm256_add_epi32(_mm256_set1_epi32(first), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    auto c1 = _mm256_set1_epi32(counter[1]);
+    auto c2 = _mm256_set1_epi32(counter[2]);
+    auto c3 = _mm256_set1_epi32(counter[3]);
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    for (size_t round = 0; round < PHILOX_ROUNDS; ++round)
+    {
+        __m256i hi0, lo0, hi1, lo1;
+        vmulhilo(c0, m0, hi0, lo0);
+        vmulhilo(c2, m1, hi1, lo1);
+        c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(k0));
+        c1 = lo1;
+        c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(k1));
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    // each 128 bit half of u[j] holds one block: blocks j and j + 4
+    const auto t0 = _mm256_unpacklo_epi32(c0, c1);
+    const auto t1 = _mm256_unpackhi_epi32(c0, c1);
+    const auto t2 = _mm256_unpacklo_epi32(c2, c3);
+    const auto t3 = _mm256_unpackhi_epi32(c2, c3);
+    const auto u0 = _mm256_unpacklo_epi64(t0, t2);
+    const auto u1 = _mm256_unpackhi_epi64(t0, t2);
+    const auto u2 = _mm256_unpacklo_epi64(t1, t3);
+    const auto u3 = _mm256_unpackhi_epi64(t1, t3);
+    auto *o = reinterpret_cast<__m256i *>(out);
+    _mm256_storeu_si256(&o[0], _mm256_permute2x128_si256(u0, u1, 0x20));
+    _mm256_storeu_si256(&o[1], _mm256_permute2x128_si256(u2, u3, 0x20));
+    _mm256_storeu_si256(&o[2], _mm256_permute2x128_si256(u0, u1, 0x31));
+    _mm256_storeu_si256(&o[3], _mm256_permute2x128_si256(u2, u3, 0x31));
+}
+
+// the tail is a whole group too, only partly copied out; calling the
+// scalar kernel for it would leave the upper halves dirty for the caller
+__attribute__((target("avx2"))) static void AVX2_Philox(const uint32_t *counter, const uint32_t *key, uint32_t *out, const size_t &blocks)
+{
+    size_t b = 0;
+    for (; b + 8 <= blocks; b += 8)
+    {
+        philox8(counter[0] + static_cast<uint32_t>(b), counter, key, &out[b * 4]);
+    }
+    if (b < blocks)
+    {
+        uint32_t tail[8 * 4];
+        philox8(counter[0] + static_cast<uint32_t>(b), counter, key, tail);
+        std::copy(tail, tail + ((blocks - b) * 4), &out[b * 4]);
+    }
+}
+
+// AVX-512; accumulation multiplies and adds separately, as the scalar
+// kernels do, rather than fused, so that every kernel set, and lane groups
+// and agents evaluated one by one, give the same bits
+
+using AVX512Vector = decltype(vload512(static_cast<const Numeric *>(nullptr)));
+constexpr size_t AVX512_LANES = sizeof(AVX512Vector) / sizeof(Numeric);
+
+__attribute__((target("avx512f"))) static void AVX512_Sigmoid(const Numeric *in, Numeric *out, const size_t &n)
+{
+    const auto one = vset512(Numeric(1));
+    size_t i = 0;
+    for (; i + AVX512_LANES <= n; i += AVX512_LANES)
+    {
+        const auto x = vload512(&in[i]);
+        vstore(&out[i], vdiv(x, vsqrt(vadd(one, vmul(x, x)))));
+    }
+    for (; i < n; ++i)
+    {
+        out[i] = sigmoid(in[i]);
+    }
+}
+
+__attribute__((target("avx512f"))) static void AVX512_Accumulate(const Numeric &x, const Numeric *row, Numeric *out, const size_t &n)
+{
+    const auto vx = vset512(x);
+    size_t i = 0;
+    for (; i + AVX512_LANES <= n; i += AVX512_LANES)
+    {
+        vstore(&out[i], vadd(vload512(&out[i]), vmul(vx, vload512(&row[i]))));
+    }
+    for (; i < n; ++i)
+    {
+        out[i] += x * row[i];
+    }
+}
+
+// a lane group is one AVX-512 vector
+static_assert(LANES == AVX512_LANES);
+
+__attribute__((target("avx512f"))) static void AVX512_LaneAccumulate(const Numeric *x, const Numeric *row, Numeric *out, const size_t &n)
+{
+    const auto vx = vload512(x);
+    for (size_t j = 0; j < n * LANES; j += LANES)
+    {
+        vstore(&out[j], vadd(vload512(&out[j]), vmul(vx, vload512(&row[j]))));
+    }
+}
+
+__attribute__((target("avx512f"))) static void AVX512_LaneThreshold(const Numeric *x, const Numeric *row, Numeric *out, const size_t &n, const Numeric &threshold)
+{
+    const auto vx = vload512(x);
+    const auto t = vset512(threshold);
+    for (size_t j = 0; j < n * LANES; j += LANES)
+    {
+        vstore(&out[j], vaddabsgt(vload512(&out[j]), vmul(vx, vload512(&row[j])), t));
+    }
+}
+
+AVX512 void vmulhilo(const __m512i &a, const __m512i &m, __m512i &hi, __m512i &lo)
+{
+    const auto even = _mm512_mul_epu32(a, m);
+    const auto odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), m);
+    hi = _mm512_mask_blend_epi32(0xaaaa, _mm512_srli_epi64(even, 32), odd);
+    lo = _mm512_mask_blend_epi32(0xaaaa, even, _mm512_slli_epi64(odd, 32));
+}
+
+// sixteen blocks side by side, as philox8
+AVX512 void philox16(const uint32_t &first, const uint32_t *counter, const uint32_t *key, uint32_t *out)
+{
+    const auto m0 = _mm512_set1_epi32(PHILOX_M0);
+    const auto m1 = _mm512_set1_epi32(PHILOX_M1);
+    auto c0 = _mm512_add_epi32(_mm512_set1_epi32(first), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    auto c1 = _mm512_set1_epi32(counter[1]);
+    auto c2 = _mm512_set1_epi32(counter[2]);
+    auto c3 = _mm512_set1_epi32(counter[3]);
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    for (size_t round = 0; round < PHILOX_ROUNDS; ++round)
+    {
+        __m512i hi0, lo0, hi1, lo1;
+        vmulhilo(c0, m0, hi0, lo0);
+        vmulhilo(c2, m1, hi1, lo1);
+        c0 = _mm512_xor_si512(_mm512_xor_si512(hi1, c1), _mm512_set1_epi32(k0));
+        c1 = lo1;
+        c2 = _mm512_xor_si512(_mm512_xor_si512(hi0, c3), _mm512_set1_epi32(k1));
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    // each 128 bit quarter of u[j] holds one block: blocks j, j + 4, j + 8
+    // and j + 12; the quarters are then transposed
+    const auto t0 = _mm512_unpacklo_epi32(c0, c1);
+    const auto t1 = _mm512_unpackhi_epi32(c0, c1);
+    const auto t2 = _mm512_unpacklo_epi32(c2, c3);
+    const auto t3 = _mm512_unpackhi_epi32(c2, c3);
+    const auto u0 = _mm512_unpacklo_epi64(t0, t2);
+    const auto u1 = _mm512_unpackhi_epi64(t0, t2);
+    const auto u2 = _mm512_unpacklo_epi64(t1, t3);
+    const auto u3 = _mm512_unpackhi_epi64(t1, t3);
+    const auto v0 = _mm512_shuffle_i32x4(u0, u1, _MM_SHUFFLE(2, 0, 2, 0));
+    const auto v1 = _mm512_shuffle_i32x4(u2, u3, _MM_SHUFFLE(2, 0, 2, 0));
+    const auto v2 = _mm512_shuffle_i32x4(u0, u1, _MM_SHUFFLE(3, 1, 3, 1));
+    const auto v3 = _mm512_shuffle_i32x4(u2, u3, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm512_storeu_si512(&out[0], _mm512_shuffle_i32x4(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm512_storeu_si512(&out[16], _mm512_shuffle_i32x4(v2, v3, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm512_storeu_si512(&out[32], _mm512_shuffle_i32x4(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+    _mm512_storeu_si512(&out[48], _mm512_shuffle_i32x4(v2, v3, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+__attribute__((target("avx512f"))) static void AVX512_Philox(const uint32_t *counter, const uint32_t *key, uint32_t *out, const size_t &blocks)
+{
+    size_t b = 0;
+    for (; b + 16 <= blocks; b += 16)
+    {
+        philox16(counter[0] + static_cast<uint32_t>(b), counter, key, &out[b * 4]);
+    }
+    if (b < blocks)
+    {
+        uint32_t tail[16 * 4];
+        philox16(counter[0] + static_cast<uint32_t>(b), counter, key, tail);
+        std::copy(tail, tail + ((blocks - b) * 4), &out[b * 4]);
+    }
+}
+
+// AVX-512 VNNI; vpdpbusd multiplies unsigned by signed bytes, so x is
+// offset by 128 and 128 * sum(w) is taken off again
+
+#define VNNI __attribute__((target("avx512f,avx512bw,avx512vnni")))
+
+VNNI static int32_t VNNI_Dot8(const int8_t *x, const int8_t *w, const size_t &n)
+{
+    const auto offset = _mm512_set1_epi8(-128);
+    const auto ones = _mm512_set1_epi8(1);
+    auto acc = _mm512_setzero_si512();
+    auto sumw = _mm512_setzero_si512();
+    for (size_t i = 0; i < n; i += 64)
+    {
+        const __mmask64 m = (n - i) >= 64 ? ~__mmask64(0) : ((__mmask64(1) << (n - i)) - 1);
+        const auto vx = _mm512_xor_si512(_mm512_maskz_loadu_epi8(m, &x[i]), offset);
+        const auto vw = _mm512_maskz_loadu_epi8(m, &w[i]);
+        acc = _mm512_dpbusd_epi32(acc, vx, vw);
+        sumw = _mm512_dpbusd_epi32(sumw, ones, vw);
+    }
+    return _mm512_reduce_add_epi32(acc) - (128 * _mm512_reduce_add_epi32(sumw));
+}
+
+VNNI static int32_t VNNI_Dot16(const int16_t *x, const int16_t *w, const size_t &n)
+{
+    auto acc = _mm512_setzero_si512();
+    for (size_t i = 0; i < n; i += 32)
+    {
+        const __mmask32 m = (n - i) >= 32 ? ~__mmask32(0) : ((__mmask32(1) << (n - i)) - 1);
+        const auto vx = _mm512_maskz_loadu_epi16(m, &x[i]);
+        const auto vw = _mm512_maskz_loadu_epi16(m, &w[i]);
+        acc = _mm512_dpwssd_epi32(acc, vx, vw);
+    }
+    return _mm512_reduce_add_epi32(acc);
+}
+
+#undef VNNI
+#undef AVX2
+#undef AVX512
+
+#endif // KERNELS_X86
+
+// Dispatch
+
+static const Kernels scalarKernels{"scalar", Scalar_Sigmoid, Scalar_Accumulate, Scalar_LaneAccumulate, Scalar_LaneThreshold, Scalar_Dot<int8_t>, Scalar_Dot<int16_t>, Scalar_Philox};
+
+#ifdef KERNELS_X86
+static const Kernels avx2Kernels{"avx2", AVX2_Sigmoid, AVX2_Accumulate, AVX2_LaneAccumulate, AVX2_LaneThreshold, AVX2_Dot8, AVX2_Dot16, AVX2_Philox};
+static const Kernels avx512Kernels{"avx512", AVX512_Sigmoid, AVX512_Accumulate, AVX512_LaneAccumulate, AVX512_LaneThreshold, AVX2_Dot8, AVX2_Dot16, AVX512_Philox};
+static const Kernels vnniKernels{"avx512vnni", AVX512_Sigmoid, AVX512_Accumulate, AVX512_LaneAccumulate, AVX512_LaneThreshold, VNNI_Dot8, VNNI_Dot16, AVX512_Philox};
+#endif // KERNELS_X86
+
+static const Kernels *activeKernels = nullptr;
+
+static bool supported(const Kernels &k)
+{
+#ifdef KERNELS_X86
+    if (&k == &vnniKernels)
+    {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni");
+    }
+    if (&k == &avx512Kernels)
+    {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2");
+    }
+    if (&k == &avx2Kernels)
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif // KERNELS_X86
+    return &k == &scalarKernels;
+}
+
+static bool matches(const Numeric &a, const Numeric &b)
+{
+    return std::abs(a - b) <= 1e-6 * std::max<Numeric>(1, std::abs(b));
+}
+
+// check k against the scalar kernels, over every length up to a few
+// vectors so that both the vector body and the scalar tail are covered
+static bool verify(const Kernels &k)
+{
+    constexpr size_t maxN = 35;
+    constexpr size_t maxDot = 133;
+    std::vector<Numeric> in(maxN), row(maxN), a(maxN), b(maxN);
+    std::vector<int8_t> x8(maxDot), w8(maxDot);
+    std::vector<int16_t> x16(maxDot), w16(maxDot);
+    for (size_t i = 0; i < maxN; ++i)
+    {
+        in[i] = ((static_cast<Numeric>((i * 37) % 101) - 50) / 7);
+        row[i] = ((static_cast<Numeric>((i * 53) % 89) - 44) / 13);
+    }
+    for (size_t i = 0; i < maxDot; ++i)
+    {
+        // cover the extremes of both types, including -128
+        x8[i] = static_cast<int8_t>((i * 37) % 256);
+        w8[i] = static_cast<int8_t>(127 - ((i * 53) % 255));
+        x16[i] = static_cast<int16_t>(((i * 7919) % 65535) - 32767);
+        w16[i] = static_cast<int16_t>(((i * 104729) % 127) - 63);
+    }
+
+    for (size_t n = 0; n <= maxDot; ++n)
+    {
+        if (k.dot8(x8.data(), w8.data(), n) != scalarKernels.dot8(x8.data(), w8.data(), n) ||
+            k.dot16(x16.data(), w16.data(), n) != scalarKernels.dot16(x16.data(), w16.data(), n))
+        {
+            return false;
+        }
+    }
+
+    for (size_t n = 0; n <= maxN; ++n)
+    {
+        scalarKernels.sigmoid(in.data(), a.data(), n);
+        k.sigmoid(in.data(), b.data(), n);
+        if (!std::equal(a.begin(), a.begin() + n, b.begin(), matches))
+        {
+            return false;
+        }
+
+        std::copy(in.begin(), in.end(), a.begin());
+        std::copy(in.begin(), in.end(), b.begin());
+        scalarKernels.accumulate(in[n % maxN], row.data(), a.data(), n);
+        k.accumulate(in[n % maxN], row.data(), b.data(), n);
+        if (!std::equal(a.begin(), a.begin() + n, b.begin(), matches))
+        {
+            return false;
+        }
+    }
+
+    // random blocks are exact; start near the wrap of the first counter word
+    constexpr size_t maxBlocks = 37;
+    const uint32_t counter[4] = {0xfffffff0, 1, 2, 3};
+    const uint32_t key[2] = {0xa4093822, 0x299f31d0};
+    std::vector<uint32_t> ra(maxBlocks * 4), rb(maxBlocks * 4);
+    for (size_t n = 0; n <= maxBlocks; ++n)
+    {
+        scalarKernels.philox(counter, key, ra.data(), n);
+        k.philox(counter, key, rb.data(), n);
+        if (!std::equal(ra.begin(), ra.begin() + (n * 4), rb.begin()))
+        {
+            return false;
+        }
+    }
+
+    // lane groups of up to a few rows; the threshold drops about half the
+    // products
+    constexpr size_t maxRows = 3;
+    std::vector<Numeric> lanes(maxRows * LANES), la(maxRows * LANES), lb(maxRows * LANES);
+    for (size_t i = 0; i < lanes.size(); ++i)
+    {
+        lanes[i] = in[i % maxN] * row[(i * 7) % maxN];
+    }
+    for (size_t n = 0; n <= maxRows; ++n)
+    {
+        std::copy(lanes.begin(), lanes.end(), la.begin());
+        std::copy(lanes.begin(), lanes.end(), lb.begin());
+        scalarKernels.laneAccumulate(&in[n], lanes.data(), la.data(), n);
+        k.laneAccumulate(&in[n], lanes.data(), lb.data(), n);
+        scalarKernels.laneThreshold(&row[n], lanes.data(), la.data(), n, 3);
+        k.laneThreshold(&row[n], lanes.data(), lb.data(), n, 3);
+        if (!std::equal(la.begin(), la.end(), lb.begin(), matches))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool selectKernels(const std::string &name)
+{
+    const std::vector<const Kernels *> candidates{
+#ifdef KERNELS_X86
+        &vnniKernels,
+        &avx512Kernels,
+        &avx2Kernels,
+#endif // KERNELS_X86
+        &scalarKernels,
+    };
+
+    for (const auto k : candidates)
+    {
+        if (name != "auto" && name != k->name)
+        {
+            continue;
+        }
+        if (!supported(*k))
+        {
+            continue;
+        }
+        if (!verify(*k))
+        {
+            std::cerr << k->name << " kernels do not match the scalar kernels; not using them" << std::endl;
+            continue;
+        }
+        activeKernels = k;
+        return true;
+    }
+
+    activeKernels = &scalarKernels;
+    return name == "auto";
+}
+
+const Kernels &getKernels()
+{
+    if (activeKernels == nullptr)
+    {
+        selectKernels("auto");
+    }
+    return *activeKernels;
+}
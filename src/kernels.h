@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "config.h"
+
+// Vector Kernels
+//
+// Activation and accumulation over whole neuron layers, also across the
+// lanes of a lane group, integer dot products for quantized brains, and
+// random number blocks for bulk generation. The widest
+// implementation the CPU supports is picked at runtime, after checking it
+// against the scalar implementation.
+
+struct Kernels
+{
+    const char *name;
+
+    // out[i] = sigmoid(in[i]); in and out may be the same array
+    void (*sigmoid)(const Numeric *in, Numeric *out, const size_t &n);
+
+    // out[i] += x * row[i]
+    void (*accumulate)(const Numeric &x, const Numeric *row, Numeric *out, const size_t &n);
+
+    // for lane groups, LANES agents side by side: out[(j * LANES) + l] +=
+    // x[l] * row[(j * LANES) + l], for j < n and every lane l
+    void (*laneAccumulate)(const Numeric *x, const Numeric *row, Numeric *out, const size_t &n);
+
+    // the same, adding only the products whose magnitude is above threshold
+    void (*laneThreshold)(const Numeric *x, const Numeric *row, Numeric *out, const size_t &n, const Numeric &threshold);
+
+    // sum of x[i] * w[i]; exact, provided the sum fits in 32 bits
+    int32_t (*dot8)(const int8_t *x, const int8_t *w, const size_t &n);
+    int32_t (*dot16)(const int16_t *x, const int16_t *w, const size_t &n);
+
+    // Philox4x32-10 for the blocks counter, counter + 1, ..., counting in the
+    // first word modulo 2^32; out gets 4 * blocks words, block after block
+    void (*philox)(const uint32_t *counter, const uint32_t *key, uint32_t *out, const size_t &blocks);
+};
+
+// name is one of auto, avx512vnni, avx512, avx2, scalar; returns false and selects
+// the scalar kernels if the named kernels are unavailable
+bool selectKernels(const std::string &name);
+const Kernels &getKernels();
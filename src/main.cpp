@@ -1,6 +1,9 @@
+#include <array>
 #include <chrono>
+#include <deque>
 #include <iomanip>
 #include <iostream>
+#include <numeric>
 #include <sstream>
 
 #ifdef FEATURE_CLI_OPTIONS
@@ -11,6 +14,12 @@
 #include <emscripten.h>
 #endif // __EMSCRIPTEN__
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif // _OPENMP
+
+#include <unistd.h>
+
 #include "config.h"
 
 Config config;
@@ -21,86 +30,37 @@ Config &getConfig()
 }
 
 #include "agent.h"
+#include "allocations.h"
+#include "batchbrain.h"
+#include "brain.h"
 #include "conditions.h"
+#include "kernels.h"
+#include "migration.h"
+#include "network.h"
 #include "neuralagent.h"
 #include "random.h"
+#include "selection.h"
 #include "sources.h"
 #include "sinks.h"
 #include "ui.h"
 #include "video.h"
 
-NeuronRegistry sourcesRegistry{
-    {"age", []()
-     { return std::make_shared<Source_Age>(); }},
-    {"direction", []()
-     { return std::make_shared<Source_Direction>(); }},
-    {"west", []()
-     { return std::make_shared<Source_West>(); }},
-    {"east", []()
-     { return std::make_shared<Source_East>(); }},
-    {"north", []()
-     { return std::make_shared<Source_North>(); }},
-    {"south", []()
-     { return std::make_shared<Source_South>(); }},
-    {"angular-velocity", []()
-     { return std::make_shared<Source_Angular_Velocity>(); }},
-    {"velocity", []()
-     { return std::make_shared<Source_Velocity>(); }},
-    {"error", []()
-     { return std::make_shared<Source_Error>(); }},
-    {"red", []()
-     { return std::make_shared<Source_Red>(); }},
-    {"green", []()
-     { return std::make_shared<Source_Green>(); }},
-    {"blue", []()
-     { return std::make_shared<Source_Blue>(); }},
-    {"size", []()
-     { return std::make_shared<Source_Size>(); }},
-};
-
-const NeuronRegistry &getSources()
-{
-    return sourcesRegistry;
-}
-
-NeuronRegistry sinksRegistry{
-    {"angular-velocity", []()
-     { return std::make_shared<Sink_Angular_Velocity>(); }},
-    {"direction", []()
-     { return std::make_shared<Sink_Direction>(); }},
-    {"velocity", []()
-     { return std::make_shared<Sink_Velocity>(); }},
-    {"move", []()
-     { return std::make_shared<Sink_Move>(); }},
-    {"red", []()
-     { return std::make_shared<Sink_Red>(); }},
-    {"green", []()
-     { return std::make_shared<Sink_Green>(); }},
-    {"blue", []()
-     { return std::make_shared<Sink_Blue>(); }},
-    {"size", []()
-     { return std::make_shared<Sink_Size>(); }},
-};
-
-const NeuronRegistry &getSinks()
-{
-    return sinksRegistry;
-}
-
-Position RandomPosition(const size_t maxx, const size_t maxy)
+// uniform variates u[0] and u[1] scaled to a position
+Position RandomPosition(const size_t maxx, const size_t maxy, const Numeric *u)
 {
     Position p;
-    p.x = std::abs(maxx * bipolarrandf());
-    p.y = std::abs(maxy * bipolarrandf());
+    p.x = std::abs(maxx * ((2 * u[0]) - 1));
+    p.y = std::abs(maxy * ((2 * u[1]) - 1));
     return p;
 }
 
-Colour RandomColour()
+// uniform variates u[0] to u[2] scaled to a colour
+Colour RandomColour(const Numeric *u)
 {
     Colour c;
-    c.r = 255 * randf();
-    c.g = 255 * randf();
-    c.b = 255 * randf();
+    c.r = 255 * u[0];
+    c.g = 255 * u[1];
+    c.b = 255 * u[2];
     return c;
 }
 
@@ -108,158 +68,810 @@ Colour RandomColour()
 
 struct Population
 {
-    std::vector<Agent::SP> agents;
+    // the island this is, of islands; it has size agents
+    size_t island = 0;
+    size_t size = 0;
+
+    // coordinator mode: workers run the agents and send their errors, so
+    // the population only selects and breeds
+    bool remote = false;
+
+    // agent i's state is slot i of the store
+    PopulationStore store;
+
+    // two generations, set up once; the children of the current agents are
+    // bred into the other buffer in place, then the two swap roles. Each
+    // buffer's genomes are in their own pool.
+    std::vector<NeuralAgent> agents;
+    std::vector<NeuralAgent> children;
+    GenomePool genomes;
+    GenomePool childGenomes;
+
+    LaneBrain lanes;
+    BatchBrain batch;
+
+    // selection and its scratch, kept between generations
+    Selection selection;
+    std::vector<Numeric> errors;
+    std::vector<size_t> survivors;
+    std::vector<Numeric> errorSums;
+
+    // the best agents, sent on to the next island
+    std::vector<size_t> migrants;
 
     PopulationStats stats;
-} population;
 
-void InitialCondition(Agent::SP a)
+    // island mode: the stats of each generation of the running epoch
+    std::vector<PopulationStats> history;
+};
+
+// the population, or in island mode the islands, each with the queue of
+// migrants into it; one island is the plain population
+std::deque<Population> islands;
+std::deque<MigrationQueue> migrations;
+
+// initial conditions take nine uniform variates, drawn in one go
+void InitialCondition(Agent &a, RandomStream &rng)
 {
-    a->size(config.MIN_SIZE + (randf() * (config.MAX_SIZE - config.MIN_SIZE)));
-    a->position(RandomPosition(config.SCREEN_WIDTH, config.SCREEN_HEIGHT));
-    a->colour(RandomColour());
-    a->direction(randf() * TWOPI);
-    a->velocity(bipolarrandf() * config.MAX_VELOCITY);
-    a->angular_vel(bipolarrandf() * config.MAX_ANGULAR_VELOCITY);
+    std::array<Numeric, 9> u;
+    rng.uniform(u);
+    a.size(config.MIN_SIZE + (u[0] * (config.MAX_SIZE - config.MIN_SIZE)));
+    a.position(RandomPosition(config.SCREEN_WIDTH, config.SCREEN_HEIGHT, &u[1]));
+    a.colour(RandomColour(&u[3]));
+    a.direction(u[6] * TWOPI);
+    a.velocity(((2 * u[7]) - 1) * config.MAX_VELOCITY);
+    a.angular_vel(((2 * u[8]) - 1) * config.MAX_ANGULAR_VELOCITY);
 }
 
-int InitPopulation()
+// mutation noise is drawn a chunk of weights at a time
+constexpr size_t MUTATION_CHUNK = 256;
+
+void Mutate(NeuralAgent &a, RandomStream &rng)
 {
-    population.agents.clear();
+    const auto w = a.weights();
+    const auto m = a.enabled();
+    // auto &d = a->weight_delta();
+    std::array<Numeric, MUTATION_CHUNK> noise;
+    for (size_t j = 0; j < w.size(); ++j)
+    {
+        if (j % MUTATION_CHUNK == 0)
+        {
+            rng.bipolar(std::span(noise).first(std::min(MUTATION_CHUNK, w.size() - j)));
+        }
+        // const auto p = d[j] * rng.randf() * config.MUTATION;
+        const auto p = noise[j % MUTATION_CHUNK] * config.MUTATION;
+        if (config.BOUNDED_WEIGHTS)
+        {
+            w[j] = std::max(
+                -config.MAX_WEIGHT,
+                std::min(
+                    config.MAX_WEIGHT,
+                    w[j] + p));
+        }
+        else
+        {
+            w[j] += p;
+        }
+        // prune; weak connections are disabled for good
+        if (std::abs(w[j]) < config.NEURAL_PRUNE_WEIGHT)
+        {
+            m[j] = 0;
+        }
+        // if (rng.randf() < config.MUTATION)
+        // {
+        //     d[j] *= -1; // swap mutation direction
+        // }
+    }
+}
 
-    for (size_t i = 0; i < config.NUMBOIDS; ++i)
+void LoadBrains(Population &population)
+{
+    // in lane groups where the population allows, else in blocks; both
+    // copy every brain into memory, so streamed genomes go agent by agent
+    population.batch.clear();
+    population.lanes.clear();
+    if (population.genomes.mapped() || population.remote)
+    {
+        return;
+    }
+    if (!population.lanes.load(population.agents))
     {
-        auto a = std::make_shared<NeuralAgent>();
-        population.agents.push_back(a);
-        InitialCondition(a);
+        population.batch.load(population.agents);
+    }
+}
 
-        a->updateType(config.NEURAL_UPDATE_TYPE);
-        a->brainType(config.NEURAL_BRAIN_TYPE);
+// a new random population, drawn for generation
+int InitPopulation(Population &population, const size_t &generation)
+{
+    const auto size = population.size;
 
-        // randomize brain weights
-        auto &b = a->brain();
-        for (size_t j = 0; j < b.size(); ++j)
+    // allocate both generations up front; re-populating reuses them
+    if (population.agents.size() != size)
+    {
+        // every agent has the configured brain; a genome file holds a
+        // generation each, as path.0 and path.1, or path.island.0 and
+        // path.island.1 in island mode. Workers on one machine may be given
+        // the same path, so each adds its process id
+        const auto connections = BrainTopology::get(config.NEURAL_BRAIN_TYPE, config.NEURAL_UPDATE_TYPE).connections.size();
+        auto path = config.NEURAL_GENOME_FILE;
+        if (!path.empty() && config.ISLANDS > 1)
+        {
+            path += "." + std::to_string(population.island);
+        }
+        if (!path.empty() && !config.WORKER_ADDRESS.empty())
         {
-            std::get<1>(b[j]) = bipolarrandf();
+            path += ".worker" + std::to_string(getpid());
         }
+        if (!population.genomes.resize(size, connections, path.empty() ? path : path + ".0") ||
+            !population.childGenomes.resize(size, connections, path.empty() ? path : path + ".1"))
+        {
+            std::cerr << "cannot map genome files " << path << ".0 and .1" << std::endl;
+            return 1;
+        }
+
+        population.store.resize(size);
+        population.agents.clear();
+        population.children.clear();
+        population.agents.reserve(size);
+        population.children.reserve(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            population.agents.emplace_back(population.store, population.genomes, i);
+            population.children.emplace_back(population.store, population.childGenomes, i);
+        }
+        population.errors.reserve(size);
+        population.survivors.reserve(size);
+        population.migrants.reserve(config.ISLAND_MIGRANTS);
+        population.history.resize(config.ISLAND_MIGRATION_INTERVAL);
+    }
+
+#pragma omp parallel for
+    for (size_t i = 0; i < size; ++i)
+    {
+        RandomStream rng(RandomUse::INITIAL_POPULATION, generation, i, population.island);
+        auto &a = population.agents[i];
+        a.resetBrain(rng);
+        InitialCondition(a, rng);
+
+        a.updateType(config.NEURAL_UPDATE_TYPE);
+        a.brainType(config.NEURAL_BRAIN_TYPE);
+
+        // randomize brain weights
+        rng.bipolar(a.weights());
     }
 
+    LoadBrains(population);
     return 0;
 }
 
-int NextGeneration(size_t generation)
+// island mode: at the end of every ISLAND_MIGRATION_INTERVAL generations,
+// the best agents of the generation go to the next island, in a ring, and
+// the migrants the previous island sent at the end of the last interval
+// take the place of the last children. Islands only wait for each other
+// between intervals, so the migrants arrive an interval late, and a seed
+// gives the same run however the islands are scheduled.
+void Migrate(Population &population, const size_t &generation)
 {
-    std::vector<Agent::SP> survivors;
-    // remove dead
+    const auto &interval = config.ISLAND_MIGRATION_INTERVAL;
+    if (islands.size() < 2 || config.ISLAND_MIGRANTS == 0 || (generation + 1) % interval != 0)
+    {
+        return;
+    }
+    auto &inbox = migrations[population.island];
+    auto &outbox = migrations[(population.island + 1) % islands.size()];
+
+    // the oldest batch is the last interval's, even when the previous
+    // island has already sent this one's; there is none the first time.
+    // The children were just bred, so their brains are recompiled anyway
+    auto &children = population.children;
+    if (generation + 1 > interval)
+    {
+        inbox.pop(children.front().genomes(), children.size() - inbox.size());
+    }
+
+    // the queue holds two batches, so there is always room
+    population.selection.fittest(population.errors, outbox.size(), population.migrants);
+    outbox.push(population.agents.front().genomes(), population.migrants);
+}
+
+// every agent's error, in one pass over the store
+void Evaluate(Population &population)
+{
+    population.lanes.store();
+    ErrorFunction(population.store, population.errors);
+}
+
+int NextGeneration(Population &population, size_t generation)
+{
+    // a remote population's errors are already in
+    if (!population.remote)
+    {
+        Evaluate(population);
+    }
+    auto &errors = population.errors;
+
+    // remove dead; the sum is taken over fixed blocks, so that it does not
+    // depend on the number of threads
+    constexpr size_t BLOCK_SIZE = SELECTION_BLOCK_SIZE;
+    const size_t numBlocks = (errors.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    auto &blockSums = population.errorSums;
+    blockSums.resize(numBlocks);
     Numeric minError = INFINITY;
     Numeric maxError = 0;
-    Numeric sumError = 0;
-    for (auto e : population.agents)
+#pragma omp parallel for reduction(min : minError) reduction(max : maxError)
+    for (size_t b = 0; b < numBlocks; ++b)
     {
-        const auto error = ErrorFunction(e);
-        minError = std::min(error, minError);
-        maxError = std::max(error, maxError);
-        sumError += error;
+        Numeric sum = 0;
+        const auto end = std::min(errors.size(), (b + 1) * BLOCK_SIZE);
+        for (size_t i = b * BLOCK_SIZE; i < end; ++i)
+        {
+            minError = std::min(errors[i], minError);
+            maxError = std::max(errors[i], maxError);
+            sum += errors[i];
+        }
+        blockSums[b] = sum;
     }
+    const auto sumError = std::accumulate(blockSums.begin(), blockSums.end(), Numeric(0));
 
     population.stats.minError = minError;
-    population.stats.avgError = sumError / population.agents.size();
+    population.stats.avgError = sumError / errors.size();
     population.stats.maxError = maxError;
-    population.stats.errThreshold = ((maxError - minError) * 0.008) + minError;
-    for (auto e : population.agents)
+    auto &survivors = population.survivors;
+    population.stats.errThreshold = population.selection.select(errors, minError, maxError, generation, population.island, survivors);
+    population.stats.survivors = population.selection.parents();
+
+    if (survivors.empty())
     {
-        const auto error = ErrorFunction(e);
-        if (error < population.stats.errThreshold)
+        // re-popluate; only threshold selection leaves no survivors, when
+        // every agent has the same error
+        // std::cout << "Everyone's dead, Dave. Re-populating in generation " << (generation + 1) << std::endl;
+        InitPopulation(population, generation + 1);
+        survivors.resize(population.agents.size());
+        std::iota(survivors.begin(), survivors.end(), 0);
+    }
+
+    // reproduce;
+    // overwrite the other generation with mutated clones of the survivors'
+    // brains, in the same store slots; each child draws from its own stream
+    auto &nextpop = population.children;
+#pragma omp parallel for
+    for (size_t i = 0; i < population.size; ++i)
+    {
+        RandomStream rng(RandomUse::BREEDING, generation, i, population.island);
+        const auto &cloneFrom = population.agents[survivors[i % survivors.size()]];
+        nextpop[i].inherit(cloneFrom, rng);
+
+        // New initial conditions
+        InitialCondition(nextpop[i], rng);
+
+        Mutate(nextpop[i], rng);
+    }
+    Migrate(population, generation);
+
+    population.agents.swap(nextpop);
+    LoadBrains(population);
+    return 0;
+}
+
+// UI
+
+int UpdateAgents(Population &population, const size_t &iter, const bool &drawn)
+{
+    // sinks that cannot affect the error only need to act when drawn
+    const auto sliced = !drawn;
+    if (population.lanes.loaded())
+    {
+        population.lanes.update(iter, sliced);
+        if (!sliced)
         {
-            survivors.push_back(e);
+            population.lanes.store();
         }
+        return 0;
+    }
+    if (population.batch.loaded())
+    {
+        population.batch.update(iter, sliced);
+        return 0;
     }
-    population.stats.survivors = survivors.size();
 
-    // std::cout
-    //     << /*"generation" <<*/ generation << ","
-    //     << /*" min error = " <<*/ minError << ","
-    //     << /*" max error = " <<*/ maxError << ","
-    //     << /*" survivors = " <<*/ survivors.size() << ","
-    //     << /*" error pct = " <<*/ errThreshold
-    //     << std::endl;
+#pragma omp parallel for
+    for (auto &a : population.agents)
+    {
+        a.update(iter, sliced);
+    }
 
-    population.stats.survivors = survivors.size();
-    if (population.stats.survivors == 0)
+    if (getConfig().NEURAL_VERIFY_INCREMENTAL && incrementalMismatches() > 0)
     {
-        // re-popluate
-        // std::cout << "Everyone's dead, Dave. Re-populating in generation " << (generation + 1) << std::endl;
-        InitPopulation();
-        survivors.swap(population.agents);
+        std::cerr << "incremental brain evaluation differs from full evaluation" << std::endl;
+        return 1;
     }
 
-    // reproduce;
-    // create another full population based on clones of the survivors' brains
-    std::vector<Agent::SP> nextpop;
-    for (size_t i = 0; i < config.NUMBOIDS; ++i)
+    return 0;
+}
+
+typedef std::chrono::steady_clock::time_point tp;
+const auto now = std::chrono::steady_clock::now;
+const auto dt = [](tp begin, tp end)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+};
+
+// ticks per second of the configured population, undrawn, at 1, 2, 4...
+// up to BENCHMARK_THREADS threads; each count starts from the same initial
+// population, with brains loaded for that many threads. Agents share no
+// state while they tick, so on enough cores the rate should scale with the
+// threads
+int BenchmarkThreads()
+{
+    using clock = std::chrono::steady_clock;
+    auto &population = islands.emplace_back();
+    population.size = config.NUMBOIDS;
+
+    std::vector<size_t> counts;
+    for (size_t threads = 1; threads < config.BENCHMARK_THREADS; threads *= 2)
     {
-        auto cloneFrom = std::static_pointer_cast<NeuralAgent>(survivors[i % survivors.size()]);
-        auto a = std::make_shared<NeuralAgent>(cloneFrom);
-        auto e = std::static_pointer_cast<Agent>(a);
-        nextpop.push_back(e);
+        counts.push_back(threads);
+    }
+    counts.push_back(config.BENCHMARK_THREADS);
 
-        // New initial conditions
-        InitialCondition(nextpop[i]);
+    std::cout << "threads,ticks/s,agent ticks/s,speedup" << std::endl;
+    double base = 0;
+    for (const auto &threads : counts)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(threads);
+#endif // _OPENMP
+        if (InitPopulation(population, 0) != 0)
+        {
+            return 1;
+        }
+
+        const auto start = clock::now();
+        for (size_t i = 0; i < config.GEN_ITERS; ++i)
+        {
+            if (UpdateAgents(population, i, false) != 0)
+            {
+                return 1;
+            }
+        }
+        const std::chrono::duration<double> elapsed = clock::now() - start;
+
+        const auto rate = config.GEN_ITERS / elapsed.count();
+        base = base == 0 ? rate : base;
+        std::cout
+            << threads << ","
+            << rate << ","
+            << rate * population.size << ","
+            << rate / base
+            << std::endl;
+    }
+    return 0;
+}
+
+// fitness trajectory, as CSV; compare runs of the double and single
+// precision builds with the same seed
+void PrintStats(const size_t &generation, const PopulationStats &stats)
+{
+    std::cout
+        << generation << ","
+        << stats.minError << ","
+        << stats.maxError << ","
+        << stats.survivors << ","
+        << stats.errThreshold
+        << std::endl;
+}
+
+// island mode: the agents are split into ISLANDS populations, the first
+// ones taking the remainder, that evolve apart, without drawing, each on
+// its own group of threads; the islands run an interval of generations at
+// a time, then report their stats per island and together
+int RunIslands()
+{
+    const auto n = config.ISLANDS;
+    const auto &interval = config.ISLAND_MIGRATION_INTERVAL;
+    islands.resize(n);
+    for (size_t k = 0; k < n; ++k)
+    {
+        islands[k].island = k;
+        islands[k].size = config.NUMBOIDS / n + (k < config.NUMBOIDS % n ? 1 : 0);
     }
 
-    // mutate
-    for (auto e : nextpop)
+    // every batch of migrants fits the smallest island
+    const auto connections = BrainTopology::get(config.NEURAL_BRAIN_TYPE, config.NEURAL_UPDATE_TYPE).connections.size();
+    const auto migrants = std::min(config.ISLAND_MIGRANTS, islands.back().size);
+    migrations.resize(n);
+    for (auto &queue : migrations)
     {
-        auto a = std::static_pointer_cast<NeuralAgent>(e);
-        auto &b = a->brain();
-        // auto &d = a->weight_delta();
-        for (size_t j = 0; j < b.size(); ++j)
+        queue.resize(2, migrants, connections);
+    }
+
+    // an island's brains size their scratch for its group of threads, so
+    // they are loaded, as well as run, from the island's own thread
+#ifdef _OPENMP
+    omp_set_max_active_levels(2);
+    const auto group = std::max(1, omp_get_max_threads() / static_cast<int>(n));
+#endif // _OPENMP
+
+    int failed = 0;
+#pragma omp parallel for num_threads(n) proc_bind(spread) schedule(static, 1) reduction(|| : failed)
+    for (size_t k = 0; k < n; ++k)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(group);
+#endif // _OPENMP
+        failed = InitPopulation(islands[k], 0) != 0 || failed;
+    }
+    if (failed)
+    {
+        return 1;
+    }
+
+    std::cout << "generation,island,minError,maxError,survivors,errorThreshold" << std::endl;
+
+    for (size_t begin = 0; begin < config.MAX_GENS; begin += interval)
+    {
+        const auto end = std::min(begin + interval, config.MAX_GENS);
+
+#pragma omp parallel for num_threads(n) proc_bind(spread) schedule(static, 1) reduction(|| : failed)
+        for (size_t k = 0; k < n; ++k)
         {
-            // const auto p = d[j] * randf() * config.MUTATION;
-            const auto p = bipolarrandf() * config.MUTATION;
-            if (config.BOUNDED_WEIGHTS)
+#ifdef _OPENMP
+            omp_set_num_threads(group);
+#endif // _OPENMP
+            auto &population = islands[k];
+            for (size_t g = begin; g < end && !failed; ++g)
             {
-                std::get<1>(b[j]) = std::max(
-                    -config.MAX_WEIGHT,
-                    std::min(
-                        config.MAX_WEIGHT,
-                        std::get<1>(b[j]) + p));
+                for (size_t i = 0; i < config.GEN_ITERS && !failed; ++i)
+                {
+                    failed = UpdateAgents(population, i, false) != 0;
+                }
+                failed = failed || NextGeneration(population, g) != 0;
+                population.history[g - begin] = population.stats;
             }
-            else
+        }
+        if (failed)
+        {
+            return 1;
+        }
+
+        for (size_t g = begin; g < end; ++g)
+        {
+            PopulationStats all = islands.front().history[g - begin];
+            for (const auto &population : islands)
             {
-                std::get<1>(b[j]) += p;
+                const auto &stats = population.history[g - begin];
+                std::cout
+                    << g << ","
+                    << population.island << ","
+                    << stats.minError << ","
+                    << stats.maxError << ","
+                    << stats.survivors << ","
+                    << stats.errThreshold
+                    << std::endl;
+                if (population.island != 0)
+                {
+                    all.minError = std::min(all.minError, stats.minError);
+                    all.maxError = std::max(all.maxError, stats.maxError);
+                    all.survivors += stats.survivors;
+                    all.errThreshold = std::max(all.errThreshold, stats.errThreshold);
+                }
             }
-            // if (randf() < config.MUTATION)
-            // {
-            //     d[j] *= -1; // swap mutation direction
-            // }
+            std::cout
+                << g << ",all,"
+                << all.minError << ","
+                << all.maxError << ","
+                << all.survivors << ","
+                << all.errThreshold
+                << std::endl;
+        }
+
+        if (ProcessEvents() != 0)
+        {
+            return 1;
         }
     }
 
-    population.agents.swap(nextpop);
     return 0;
 }
 
-// UI
+// Distributed mode
+//
+// A coordinator keeps the population, and selects and breeds it; each
+// generation, it sends every worker a slice of the agents, the first
+// workers taking the remainder, and the workers run the generation's ticks
+// and send back the agents' errors. Workers run headless, with the same
+// options as the coordinator, so a seed gives the same run as in a single
+// process, however many workers there are.
+
+// seconds a worker keeps trying to reach its coordinator
+constexpr int WORKER_CONNECT_TIMEOUT = 10;
+
+// a hash of the options the agents' ticks depend on, and the population
+// size that slices them; a worker whose fingerprint differs from the
+// coordinator's would send errors for another simulation. The seed is left
+// out, as workers draw nothing, and so are the kernels, which all give the
+// same bits
+uint64_t SimulationFingerprint()
+{
+    Message options;
+    options.reset(MessageType::HELLO);
+    const auto putStrings = [&](const std::vector<std::string> &strings)
+    {
+        options.put<uint64_t>(strings.size());
+        for (const auto &s : strings)
+        {
+            options.put<uint64_t>(s.size());
+            options.put(std::span<const char>(s));
+        }
+    };
+    options.put<uint64_t>(sizeof(Numeric));
+    options.put(config.SCREEN_WIDTH);
+    options.put(config.SCREEN_HEIGHT);
+    options.put(config.NUMBOIDS);
+    options.put(config.NUM_MEMORY_PER_LAYER);
+    options.put(config.NUM_MEMORY_LAYERS);
+    putStrings(config.NEURON_SOURCES);
+    putStrings(config.NEURON_SINKS);
+    options.put(config.NEURAL_THRESHOLD);
+    options.put(config.NEURAL_UPDATE_TYPE);
+    options.put(config.NEURAL_BRAIN_TYPE);
+    options.put(config.NEURAL_COMPILED);
+    options.put(config.NEURAL_BATCHED);
+    options.put(config.NEURAL_SPECIALIZED);
+    options.put(config.NEURAL_PRUNE_WEIGHT);
+    options.put(config.NEURAL_SPARSE_DENSITY);
+    options.put(config.NEURAL_INCREMENTAL);
+    options.put(config.NEURAL_QUANTIZE_BITS);
+    options.put(config.NEURAL_SLICED);
+    options.put(config.NEURAL_LANES);
+    options.put(config.BOUNDED_WEIGHTS);
+    options.put(config.MAX_WEIGHT);
+    options.put(config.MIN_SIZE);
+    options.put(config.MAX_SIZE);
+    options.put(config.MAX_VELOCITY);
+    options.put(config.MAX_ANGULAR_VELOCITY);
+    options.put(config.GEN_ITERS);
+    return options.hash();
+}
 
-int UpdateAgents(const size_t &iter)
+// the payload size of a WORK message of count agents
+size_t WorkSize(const size_t &count, const size_t &connections)
 {
-#pragma omp parallel for
-    for (auto &entity : population.agents)
+    const auto state = (6 * sizeof(Numeric)) + sizeof(Colour);
+    const auto genome = (connections * sizeof(Numeric)) + ((connections + 7) / 8);
+    return sizeof(uint64_t) + (count * (state + genome));
+}
+
+// the HELLO payload: connections per brain, Numeric size and fingerprint
+constexpr size_t HELLO_SIZE = 3 * sizeof(uint64_t);
+
+// agents first onwards, count of them, as a WORK message: the agents' state,
+// field by field as in the store, then each genome's weights and enable
+// flags, the flags eight to a byte; the mutation directions stay with the
+// coordinator
+void PackAgents(const Population &population, const size_t &first, const size_t &count, Message &message)
+{
+    const auto &store = population.store;
+    message.reset(MessageType::WORK);
+    message.put<uint64_t>(count);
+    message.put(std::span(store.size).subspan(first, count));
+    message.put(std::span(store.velocity).subspan(first, count));
+    message.put(std::span(store.x).subspan(first, count));
+    message.put(std::span(store.y).subspan(first, count));
+    message.put(std::span(store.colour).subspan(first, count));
+    message.put(std::span(store.angular_vel).subspan(first, count));
+    message.put(std::span(store.direction).subspan(first, count));
+    for (size_t i = first; i < first + count; ++i)
     {
-        auto a = std::static_pointer_cast<NeuralAgent>(entity);
-        a->update(iter);
+        const auto &a = population.agents[i];
+        message.put(a.weights());
+        const auto e = a.enabled();
+        for (size_t j = 0; j < e.size(); j += 8)
+        {
+            uint8_t bits = 0;
+            for (size_t b = 0; b < 8 && j + b < e.size(); ++b)
+            {
+                bits |= (e[j + b] != 0) << b;
+            }
+            message.put(bits);
+        }
     }
+}
 
+// the agents of a WORK message, over the whole population, which is resized
+// to fit them; false if the message does not hold them
+bool UnpackAgents(Population &population, Message &message)
+{
+    const auto count = message.get<uint64_t>();
+    if (count == 0 || count > config.NUMBOIDS)
+    {
+        return false;
+    }
+    if (population.size != count)
+    {
+        // the brains are drawn at random, then overwritten
+        population.size = count;
+        if (InitPopulation(population, 0) != 0)
+        {
+            return false;
+        }
+    }
+
+    auto &store = population.store;
+    message.get(std::span(store.size));
+    message.get(std::span(store.velocity));
+    message.get(std::span(store.x));
+    message.get(std::span(store.y));
+    message.get(std::span(store.colour));
+    message.get(std::span(store.angular_vel));
+    message.get(std::span(store.direction));
+    for (auto &a : population.agents)
+    {
+        message.get(a.weights());
+        const auto e = a.enabled();
+        for (size_t j = 0; j < e.size(); j += 8)
+        {
+            const auto bits = message.get<uint8_t>();
+            for (size_t b = 0; b < 8 && j + b < e.size(); ++b)
+            {
+                e[j + b] = (bits >> b) & 1;
+            }
+        }
+    }
+    return message.valid();
+}
+
+int RunCoordinator()
+{
+    Listener listener;
+    if (!listener.listen(config.COORDINATOR_ADDRESS))
+    {
+        std::cerr << "cannot listen at " << config.COORDINATOR_ADDRESS << std::endl;
+        return 1;
+    }
+
+    // every worker must run the same simulation, in the same precision
+    const uint64_t connections = BrainTopology::get(config.NEURAL_BRAIN_TYPE, config.NEURAL_UPDATE_TYPE).connections.size();
+    const auto fingerprint = SimulationFingerprint();
+    std::vector<Connection> workers;
+    Message message;
+    for (size_t w = 0; w < config.COORDINATOR_WORKERS; ++w)
+    {
+        auto worker = listener.accept();
+        if (!worker.connected() || !worker.receive(message, HELLO_SIZE) || message.type() != MessageType::HELLO)
+        {
+            std::cerr << "worker " << w << " did not say hello" << std::endl;
+            return 1;
+        }
+        if (message.get<uint64_t>() != connections || message.get<uint64_t>() != sizeof(Numeric) ||
+            message.get<uint64_t>() != fingerprint || !message.valid())
+        {
+            std::cerr << "worker " << w << " runs a different simulation; start workers with the coordinator's options" << std::endl;
+            return 1;
+        }
+        workers.push_back(std::move(worker));
+    }
+
+    auto &population = islands.emplace_back();
+    population.size = config.NUMBOIDS;
+    population.remote = true;
+    if (InitPopulation(population, 0) != 0)
+    {
+        return 1;
+    }
+    population.errors.resize(population.size);
+
+    const auto n = workers.size();
+    const auto slice = [&](const size_t &w)
+    { return population.size / n + (w < population.size % n ? 1 : 0); };
+
+    std::cout << "generation,minError,maxError,survivors,errorThreshold" << std::endl;
+
+    for (size_t g = 0; g < config.MAX_GENS; ++g)
+    {
+        // every worker has its slice before the first answer is read
+        for (size_t w = 0, first = 0; w < n; first += slice(w), ++w)
+        {
+            PackAgents(population, first, slice(w), message);
+            if (!workers[w].send(message))
+            {
+                std::cerr << "lost worker " << w << std::endl;
+                return 1;
+            }
+        }
+        for (size_t w = 0, first = 0; w < n; first += slice(w), ++w)
+        {
+            if (!workers[w].receive(message, slice(w) * sizeof(Numeric)) || message.type() != MessageType::ERRORS)
+            {
+                std::cerr << "lost worker " << w << std::endl;
+                return 1;
+            }
+            message.get(std::span(population.errors).subspan(first, slice(w)));
+            if (!message.valid())
+            {
+                std::cerr << "worker " << w << " sent errors for the wrong agents" << std::endl;
+                return 1;
+            }
+        }
+
+        if (NextGeneration(population, g))
+        {
+            return 1;
+        }
+        PrintStats(g, population.stats);
+
+        if (ProcessEvents() != 0)
+        {
+            return 1;
+        }
+    }
+
+    message.reset(MessageType::DONE);
+    for (auto &worker : workers)
+    {
+        worker.send(message);
+    }
     return 0;
 }
 
-typedef std::chrono::steady_clock::time_point tp;
-const auto now = std::chrono::steady_clock::now;
-const auto dt = [](tp begin, tp end)
+int RunWorker()
 {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
-};
+    auto coordinator = connectTo(config.WORKER_ADDRESS, WORKER_CONNECT_TIMEOUT);
+    if (!coordinator.connected())
+    {
+        std::cerr << "cannot connect to " << config.WORKER_ADDRESS << std::endl;
+        return 1;
+    }
+
+    const auto connections = BrainTopology::get(config.NEURAL_BRAIN_TYPE, config.NEURAL_UPDATE_TYPE).connections.size();
+    Message message;
+    message.reset(MessageType::HELLO);
+    message.put<uint64_t>(connections);
+    message.put<uint64_t>(sizeof(Numeric));
+    message.put<uint64_t>(SimulationFingerprint());
+    if (!coordinator.send(message))
+    {
+        std::cerr << "lost the coordinator" << std::endl;
+        return 1;
+    }
+
+    auto &population = islands.emplace_back();
+    while (true)
+    {
+        if (!coordinator.receive(message, WorkSize(config.NUMBOIDS, connections)))
+        {
+            std::cerr << "lost the coordinator" << std::endl;
+            return 1;
+        }
+        if (message.type() == MessageType::DONE)
+        {
+            return 0;
+        }
+        if (message.type() != MessageType::WORK || !UnpackAgents(population, message))
+        {
+            std::cerr << "the coordinator sent agents this worker cannot run" << std::endl;
+            return 1;
+        }
+
+        LoadBrains(population);
+        for (size_t i = 0; i < config.GEN_ITERS; ++i)
+        {
+            if (UpdateAgents(population, i, false) != 0)
+            {
+                return 1;
+            }
+        }
+        Evaluate(population);
+
+        message.reset(MessageType::ERRORS);
+        message.put(std::span<const Numeric>(population.errors));
+        if (!coordinator.send(message))
+        {
+            std::cerr << "lost the coordinator" << std::endl;
+            return 1;
+        }
+    }
+}
 
 int cleanup(int returnCode)
 {
@@ -350,6 +962,71 @@ int ParseArgs(int argc, char *argv[])
                 return std::string{"layered"};
             })
         .help("Neurons: Connection type. Choose from: no-memory, layered, fully-connected");
+    program.add_argument("--neuron-uncompiled")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Neurons: Evaluate brains connection by connection instead of as compiled weight matrices");
+    program.add_argument("--neuron-kernels")
+        .default_value(std::string("auto"))
+        .action(
+            [](const std::string &value)
+            {
+                static const std::vector<std::string> choices = {"auto", "avx512vnni", "avx512", "avx2", "scalar"};
+                if (std::find(choices.begin(), choices.end(), value) != choices.end())
+                {
+                    return value;
+                }
+                return std::string{"auto"};
+            })
+        .help("Neurons: Vector kernels for compiled brains. Choose from: auto, avx512vnni, avx512, avx2, scalar");
+    program.add_argument("--neuron-unspecialized")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Neurons: Do not use kernels specialized for common layered brain shapes");
+    program.add_argument("--neuron-prune-weight")
+        .default_value(0.0f)
+        .action(AsFloat)
+        .help("Neurons: Mutation disables connections whose weight magnitude falls below this");
+    program.add_argument("--neuron-sparse-density")
+        .default_value(0.5f)
+        .action(AsFloat)
+        .help("Neurons: Evaluate brain layers with a smaller fraction of enabled connections as sparse");
+    program.add_argument("--neuron-unbatched")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Neurons: Evaluate compiled brains agent by agent instead of in population blocks");
+    program.add_argument("--neuron-incremental")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Neurons: Re-evaluate max and threshold brains only through connections whose source changed");
+    program.add_argument("--neuron-verify-incremental")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Neurons: Check every incremental evaluation against a full one, and stop on a mismatch");
+    program.add_argument("--neuron-quantize")
+        .default_value(std::string("off"))
+        .action(
+            [](const std::string &value)
+            {
+                static const std::vector<std::string> choices = {"off", "int8", "int16"};
+                if (std::find(choices.begin(), choices.end(), value) != choices.end())
+                {
+                    return value;
+                }
+                return std::string{"off"};
+            })
+        .help("Neurons: Evaluate every-update brains with integer weights. Choose from: off, int8, int16");
+    program.add_argument("--neuron-unsliced")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Neurons: Evaluate sinks that cannot affect the error function even in iterations that are not drawn");
+    program.add_argument("--neuron-unlaned")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Neurons: Evaluate batched brains in blocks of whole agents instead of in SIMD lane groups");
+    program.add_argument("--neuron-genome-file")
+        .default_value(std::string(""))
+        .help("Neurons: Keep the genomes in files mapped from this path, with .0 and .1 appended, and stream them agent by agent, for populations whose brains do not fit in memory");
 
     program.add_argument("-p", "--agent-min-size")
         .default_value(5.0f)
@@ -384,6 +1061,57 @@ int ParseArgs(int argc, char *argv[])
         .default_value(400L)
         .action(AsLong)
         .help("Simulation: Iterations per generation");
+    program.add_argument("--simulation-selection")
+        .default_value(std::string("threshold"))
+        .action(
+            [](const std::string &value)
+            {
+                static const std::vector<std::string> choices = {"threshold", "top-k", "tournament", "rank"};
+                if (std::find(choices.begin(), choices.end(), value) != choices.end())
+                {
+                    return value;
+                }
+                return std::string{"threshold"};
+            })
+        .help("Simulation: How the parents of the next generation are selected. Choose from: threshold, top-k, tournament, rank");
+    program.add_argument("--simulation-selection-fraction")
+        .default_value(0.1f)
+        .action(AsFloat)
+        .help("Simulation: Share of the agents kept by top-k and rank selection");
+    program.add_argument("--simulation-tournament-size")
+        .default_value(4)
+        .action(AsInt)
+        .help("Simulation: Agents drawn per tournament by tournament selection");
+    program.add_argument("--simulation-islands")
+        .default_value(1)
+        .action(AsInt)
+        .help("Simulation: Split the agents into islands that evolve apart on their own threads, without drawing");
+    program.add_argument("--simulation-migration-interval")
+        .default_value(10)
+        .action(AsInt)
+        .help("Simulation: Generations between migrations from each island to the next");
+    program.add_argument("--simulation-migrants")
+        .default_value(4)
+        .action(AsInt)
+        .help("Simulation: Best agents each island sends to the next island per migration");
+    program.add_argument("--simulation-coordinator")
+        .default_value(std::string(""))
+        .help("Simulation: Listen at unix:path or tcp:host:port for workers, which run the agents' generations");
+    program.add_argument("--simulation-workers")
+        .default_value(1)
+        .action(AsInt)
+        .help("Simulation: Workers the coordinator waits for before the first generation");
+    program.add_argument("--simulation-worker")
+        .default_value(std::string(""))
+        .help("Simulation: Run headless as a worker of the coordinator at unix:path or tcp:host:port, with the same options");
+    program.add_argument("--simulation-benchmark-threads")
+        .default_value(0)
+        .action(AsInt)
+        .help("Simulation: Report undrawn ticks per second at 1, 2, 4... up to this many threads, then exit");
+    program.add_argument("--simulation-benchmark-random")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Simulation: Report random variates per second with the selected kernels, then exit");
 
     program.add_argument("-z", "--render-zoom-factor")
         .default_value(1.0f)
@@ -412,6 +1140,13 @@ int ParseArgs(int argc, char *argv[])
         .help("Rendering: Output video scale factor");
 #endif // FEATURE_RENDER_VIDEO
 
+#ifdef FEATURE_COUNT_ALLOCATIONS
+    program.add_argument("--simulation-count-allocations")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Simulation: Report heap allocations per generation, and fail if a tick allocates once both generations are set up");
+#endif // FEATURE_COUNT_ALLOCATIONS
+
     try
     {
         program.parse_args(argc, argv);
@@ -441,6 +1176,19 @@ int ParseArgs(int argc, char *argv[])
     config.GEN_ITERS = program.get<long>("-i");
     config.ZOOM = program.get<float>("-z");
     config.REALTIME_EVERY_NGENS = program.get<int>("-u");
+    config.BENCHMARK_RANDOM = program.get<bool>("--simulation-benchmark-random");
+    config.BENCHMARK_THREADS = std::max(0, program.get<int>("--simulation-benchmark-threads"));
+    // a share of the agents, so within [0, 1], NaN as 0; selection keeps at
+    // least one
+    const auto fraction = program.get<float>("--simulation-selection-fraction");
+    config.SELECTION_FRACTION = fraction > 0 ? std::min(fraction, 1.0f) : 0;
+    config.SELECTION_TOURNAMENT_SIZE = std::max(1, program.get<int>("--simulation-tournament-size"));
+    config.ISLANDS = std::min<size_t>(std::max(1, program.get<int>("--simulation-islands")), config.NUMBOIDS);
+    config.ISLAND_MIGRATION_INTERVAL = std::max(1, program.get<int>("--simulation-migration-interval"));
+    config.ISLAND_MIGRANTS = std::max(0, program.get<int>("--simulation-migrants"));
+    config.COORDINATOR_ADDRESS = program.get<std::string>("--simulation-coordinator");
+    config.COORDINATOR_WORKERS = std::min<size_t>(std::max(1, program.get<int>("--simulation-workers")), config.NUMBOIDS);
+    config.WORKER_ADDRESS = program.get<std::string>("--simulation-worker");
 #ifdef FEATURE_RENDER_CHARTS
     config.RENDER_CHARTS = program.get<bool>("-c");
 #endif // FEATURE_RENDER_CHARTS
@@ -448,6 +1196,15 @@ int ParseArgs(int argc, char *argv[])
     config.SAVE_FRAMES = program.get<bool>("-v");
     config.VIDEO_SCALE = program.get<float>("-d");
 #endif // FEATURE_RENDER_VIDEO
+#ifdef FEATURE_COUNT_ALLOCATIONS
+    config.COUNT_ALLOCATIONS = program.get<bool>("--simulation-count-allocations");
+    // only the single population's tick loop is checked
+    if (config.COUNT_ALLOCATIONS && (config.ISLANDS > 1 || !config.COORDINATOR_ADDRESS.empty() || !config.WORKER_ADDRESS.empty()))
+    {
+        std::cerr << "--simulation-count-allocations does not work with islands, coordinators or workers" << std::endl;
+        return 1;
+    }
+#endif // FEATURE_COUNT_ALLOCATIONS
 
     std::vector<std::string> sources = program.get<std::vector<std::string>>("--neuron-sources");
     std::vector<std::string> validSources;
@@ -455,7 +1212,7 @@ int ParseArgs(int argc, char *argv[])
         sources.begin(), sources.end(),
         std::back_inserter(validSources),
         [](auto &v)
-        { return sourcesRegistry.find(v) != sourcesRegistry.end(); });
+        { return findSource(v).has_value(); });
     if (validSources.size() > 0)
     {
         config.NEURON_SOURCES.swap(validSources);
@@ -477,7 +1234,7 @@ int ParseArgs(int argc, char *argv[])
         sinks.begin(), sinks.end(),
         std::back_inserter(validSinks),
         [](auto &v)
-        { return sinksRegistry.find(v) != sinksRegistry.end(); });
+        { return findSink(v).has_value(); });
     if (validSinks.size() > 0)
     {
         config.NEURON_SINKS.swap(validSinks);
@@ -492,6 +1249,21 @@ int ParseArgs(int argc, char *argv[])
             return a + "," + b;
         });
 
+    config.NEURAL_COMPILED = !program.get<bool>("--neuron-uncompiled");
+    config.NEURAL_BATCHED = !program.get<bool>("--neuron-unbatched");
+    config.NEURAL_KERNELS = program.get<std::string>("--neuron-kernels");
+    config.NEURAL_SPECIALIZED = !program.get<bool>("--neuron-unspecialized");
+    config.NEURAL_PRUNE_WEIGHT = program.get<float>("--neuron-prune-weight");
+    config.NEURAL_SPARSE_DENSITY = program.get<float>("--neuron-sparse-density");
+    config.NEURAL_INCREMENTAL = program.get<bool>("--neuron-incremental");
+    config.NEURAL_VERIFY_INCREMENTAL = program.get<bool>("--neuron-verify-incremental");
+
+    auto quantize = program.get<std::string>("--neuron-quantize");
+    config.NEURAL_QUANTIZE_BITS = quantize == "int8" ? 8 : quantize == "int16" ? 16 : 0;
+    config.NEURAL_SLICED = !program.get<bool>("--neuron-unsliced");
+    config.NEURAL_LANES = !program.get<bool>("--neuron-unlaned");
+    config.NEURAL_GENOME_FILE = program.get<std::string>("--neuron-genome-file");
+
     auto updateType = program.get<std::string>("--neuron-update-type");
     if (updateType == "max")
     {
@@ -520,6 +1292,24 @@ int ParseArgs(int argc, char *argv[])
         config.NEURAL_BRAIN_TYPE = NeuralBrainType::FULLY_CONNECTED;
     }
 
+    auto selectionType = program.get<std::string>("--simulation-selection");
+    if (selectionType == "threshold")
+    {
+        config.SELECTION_TYPE = SelectionType::THRESHOLD;
+    }
+    if (selectionType == "top-k")
+    {
+        config.SELECTION_TYPE = SelectionType::TOP_K;
+    }
+    if (selectionType == "tournament")
+    {
+        config.SELECTION_TYPE = SelectionType::TOURNAMENT;
+    }
+    if (selectionType == "rank")
+    {
+        config.SELECTION_TYPE = SelectionType::RANK;
+    }
+
     std::cout
         << "Config:" << std::endl
         << " SEED=" << config.SEED << std::endl
@@ -531,6 +1321,18 @@ int ParseArgs(int argc, char *argv[])
         << " SINKS=" << sinkslist << std::endl
         << " NEURAL_UPDATE_TYPE=" << (int)config.NEURAL_UPDATE_TYPE << std::endl
         << " NEURAL_BRAIN_TYPE=" << (int)config.NEURAL_BRAIN_TYPE << std::endl
+        << " NEURAL_COMPILED=" << config.NEURAL_COMPILED << std::endl
+        << " NEURAL_BATCHED=" << config.NEURAL_BATCHED << std::endl
+        << " NEURAL_KERNELS=" << config.NEURAL_KERNELS << std::endl
+        << " NEURAL_SPECIALIZED=" << config.NEURAL_SPECIALIZED << std::endl
+        << " NEURAL_PRUNE_WEIGHT=" << config.NEURAL_PRUNE_WEIGHT << std::endl
+        << " NEURAL_SPARSE_DENSITY=" << config.NEURAL_SPARSE_DENSITY << std::endl
+        << " NEURAL_INCREMENTAL=" << config.NEURAL_INCREMENTAL << std::endl
+        << " NEURAL_VERIFY_INCREMENTAL=" << config.NEURAL_VERIFY_INCREMENTAL << std::endl
+        << " NEURAL_QUANTIZE_BITS=" << config.NEURAL_QUANTIZE_BITS << std::endl
+        << " NEURAL_SLICED=" << config.NEURAL_SLICED << std::endl
+        << " NEURAL_LANES=" << config.NEURAL_LANES << std::endl
+        << " NEURAL_GENOME_FILE=" << config.NEURAL_GENOME_FILE << std::endl
         << " NEURAL_THRESHOLD=" << config.NEURAL_THRESHOLD << std::endl
         << " BOUNDED_WEIGHTS=" << config.BOUNDED_WEIGHTS << std::endl
         << " MAX_WEIGHT=" << config.MAX_WEIGHT << std::endl
@@ -544,12 +1346,25 @@ int ParseArgs(int argc, char *argv[])
         << " GEN_ITERS=" << config.GEN_ITERS << std::endl
         << " ZOOM=" << config.ZOOM << std::endl
         << " REALTIME_EVERY_NGENS=" << config.REALTIME_EVERY_NGENS << std::endl
+        << " BENCHMARK_RANDOM=" << config.BENCHMARK_RANDOM << std::endl
+        << " BENCHMARK_THREADS=" << config.BENCHMARK_THREADS << std::endl
+        << " SELECTION_TYPE=" << (int)config.SELECTION_TYPE << std::endl
+        << " SELECTION_FRACTION=" << config.SELECTION_FRACTION << std::endl
+        << " SELECTION_TOURNAMENT_SIZE=" << config.SELECTION_TOURNAMENT_SIZE << std::endl
+        << " ISLANDS=" << config.ISLANDS << std::endl
+        << " ISLAND_MIGRATION_INTERVAL=" << config.ISLAND_MIGRATION_INTERVAL << std::endl
+        << " ISLAND_MIGRANTS=" << config.ISLAND_MIGRANTS << std::endl
+        << " COORDINATOR_ADDRESS=" << config.COORDINATOR_ADDRESS << std::endl
+        << " COORDINATOR_WORKERS=" << config.COORDINATOR_WORKERS << std::endl
+        << " WORKER_ADDRESS=" << config.WORKER_ADDRESS << std::endl
 #ifdef FEATURE_RENDER_VIDEO
         << " SAVE_FRAMES=" << config.SAVE_FRAMES << std::endl
-        << " VIDEO_SCALE=" << config.VIDEO_SCALE << std::endl;
-#else
-        ;
+        << " VIDEO_SCALE=" << config.VIDEO_SCALE << std::endl
 #endif // FEATURE_RENDER_VIDEO
+#ifdef FEATURE_COUNT_ALLOCATIONS
+        << " COUNT_ALLOCATIONS=" << config.COUNT_ALLOCATIONS << std::endl
+#endif // FEATURE_COUNT_ALLOCATIONS
+        ;
 
     return 0;
 }
@@ -571,6 +1386,9 @@ int ParseArgs(int argc, char *argv[])
     // NEURAL_UPDATE_TYPE is already set
     // NEURAL_BRAIN_TYPE is already set
     // BOUNDED_WEIGHTS is already set
+    // SELECTION_TYPE is already set
+    // ISLANDS is already set
+    // COORDINATOR_ADDRESS and WORKER_ADDRESS are not required
     // MAX_WEIGHT is not required
     config.MIN_SIZE = 1.5;
     config.MAX_SIZE = 15;
@@ -597,6 +1415,27 @@ int main(int argc, char *argv[])
 
     random_seed(config.SEED);
 
+    if (!selectKernels(config.NEURAL_KERNELS))
+    {
+        std::cerr << config.NEURAL_KERNELS << " kernels are not available, using " << getKernels().name << std::endl;
+    }
+
+    if (config.BENCHMARK_RANDOM)
+    {
+        benchmarkRandom();
+        return cleanup(0);
+    }
+    if (config.BENCHMARK_THREADS != 0)
+    {
+        return cleanup(BenchmarkThreads());
+    }
+
+    // workers have nothing to show
+    if (!config.WORKER_ADDRESS.empty())
+    {
+        return RunWorker();
+    }
+
     if (InitSDL() != 0)
     {
         return cleanup(1);
@@ -610,7 +1449,18 @@ int main(int argc, char *argv[])
     }
 #endif // FEATURE_RENDER_VIDEO
 
-    if (InitPopulation() != 0)
+    if (!config.COORDINATOR_ADDRESS.empty())
+    {
+        return cleanup(RunCoordinator());
+    }
+    if (config.ISLANDS > 1)
+    {
+        return cleanup(RunIslands());
+    }
+
+    auto &population = islands.emplace_back();
+    population.size = config.NUMBOIDS;
+    if (InitPopulation(population, 0) != 0)
     {
         return cleanup(1);
     }
@@ -624,6 +1474,12 @@ int main(int argc, char *argv[])
     double t = 0;
     for (size_t g = 0; g < config.MAX_GENS; g++)
     {
+#ifdef FEATURE_COUNT_ALLOCATIONS
+        // heap allocations of this generation's ticks; drawing goes through
+        // SDL, which allocates as it likes, so drawn frames count only their
+        // update
+        size_t tickAllocations = 0;
+#endif // FEATURE_COUNT_ALLOCATIONS
         for (size_t i = 0; i < config.GEN_ITERS; ++i, ++f, t_iter = now(), t = dt(t_start, t_iter) / 1000.0)
         {
             if (ProcessEvents() != 0)
@@ -631,17 +1487,26 @@ int main(int argc, char *argv[])
                 return cleanup(1);
             }
 
-            if (UpdateAgents(i) != 0)
+#ifdef FEATURE_COUNT_ALLOCATIONS
+            const auto allocations = allocationCount();
+#endif // FEATURE_COUNT_ALLOCATIONS
+            if (UpdateAgents(population, i, Rendered(g, i)) != 0)
             {
                 std::cerr << "error updating entt" << std::endl;
                 return cleanup(1);
             }
+#ifdef FEATURE_COUNT_ALLOCATIONS
+            const auto updated = allocationCount();
+#endif // FEATURE_COUNT_ALLOCATIONS
 
-            if (Render(population.agents, g, i, f, t, population.stats) != 0)
+            if (Render(population.store, g, i, f, t, population.stats) != 0)
             {
                 std::cerr << "error rendering: " << SDL_GetError() << std::endl;
                 return cleanup(1);
             }
+#ifdef FEATURE_COUNT_ALLOCATIONS
+            tickAllocations += (Rendered(g, i) ? updated : allocationCount()) - allocations;
+#endif // FEATURE_COUNT_ALLOCATIONS
 
 #ifdef __EMSCRIPTEN__
             emscripten_sleep(1);
@@ -661,10 +1526,29 @@ int main(int argc, char *argv[])
 #endif // __EMSCRIPTEN__
         }
 
-        if (NextGeneration(g))
+#ifdef FEATURE_COUNT_ALLOCATIONS
+        const auto allocations = allocationCount();
+#endif // FEATURE_COUNT_ALLOCATIONS
+        if (NextGeneration(population, g))
         {
             return cleanup(1);
         }
+
+        PrintStats(g, population.stats);
+
+#ifdef FEATURE_COUNT_ALLOCATIONS
+        if (config.COUNT_ALLOCATIONS)
+        {
+            std::cerr << "allocations: generation " << g << " ticks " << tickAllocations << " next generation " << (allocationCount() - allocations) << std::endl;
+            // the agents of the first two generations set up the two
+            // generation buffers; after that, a tick must not allocate
+            if (g >= 2 && tickAllocations != 0)
+            {
+                std::cerr << "ticks of generation " << g << " allocated " << tickAllocations << " times" << std::endl;
+                return cleanup(1);
+            }
+        }
+#endif // FEATURE_COUNT_ALLOCATIONS
     }
 
     return cleanup(0);
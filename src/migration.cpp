@@ -0,0 +1,42 @@
+#include "migration.h"
+
+void MigrationQueue::resize(const size_t &capacity, const size_t &size, const size_t &connections)
+{
+    m_capacity = capacity;
+    m_size = size;
+    m_slots.resize(capacity * size, connections, "");
+    m_head = 0;
+    m_tail = 0;
+}
+
+bool MigrationQueue::push(const GenomePool &pool, std::span<const size_t> indices)
+{
+    const auto tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == m_capacity)
+    {
+        return false;
+    }
+    const auto slot = (tail % m_capacity) * m_size;
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        m_slots.copy(slot + i, pool, indices[i]);
+    }
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool MigrationQueue::pop(GenomePool &pool, const size_t &first)
+{
+    const auto head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    const auto slot = (head % m_capacity) * m_size;
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        pool.copy(first + i, m_slots, slot + i);
+    }
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
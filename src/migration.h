@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <span>
+
+#include "genome.h"
+
+// Migration Queue
+//
+// Carries batches of genomes from one island to the next, from a single
+// producer to a single consumer, without locks: the producer only moves the
+// tail and the consumer only the head, each publishing its slot with a
+// release store that the other side acquires. The slots are genome pool
+// records, set up once, so migration does not allocate.
+
+class MigrationQueue
+{
+public:
+    // room for capacity batches of size genomes with the given connections
+    void resize(const size_t &capacity, const size_t &size, const size_t &connections);
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    // the genomes at indices of pool, as the newest batch; false if full
+    bool push(const GenomePool &pool, std::span<const size_t> indices);
+
+    // the oldest batch, over genomes first onwards of pool; false if empty
+    bool pop(GenomePool &pool, const size_t &first);
+
+private:
+    size_t m_capacity = 0;
+    size_t m_size = 0;
+    GenomePool m_slots;
+
+    // batches pushed and popped so far, on their own cache lines
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
@@ -0,0 +1,254 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "network.h"
+
+// Addresses
+
+struct Address
+{
+    int family = AF_UNSPEC;
+    sockaddr_storage storage{};
+    socklen_t length = 0;
+    std::string path;
+};
+
+static bool resolve(const std::string &address, Address &out)
+{
+    if (address.starts_with("unix:"))
+    {
+        out.path = address.substr(5);
+        sockaddr_un un{};
+        if (out.path.empty() || out.path.size() >= sizeof(un.sun_path))
+        {
+            std::cerr << "bad unix socket path in " << address << std::endl;
+            return false;
+        }
+        un.sun_family = AF_UNIX;
+        std::memcpy(un.sun_path, out.path.c_str(), out.path.size() + 1);
+        out.family = AF_UNIX;
+        out.length = sizeof(un);
+        std::memcpy(&out.storage, &un, sizeof(un));
+        return true;
+    }
+
+    if (address.starts_with("tcp:"))
+    {
+        const auto hostport = address.substr(4);
+        const auto colon = hostport.rfind(':');
+        if (colon == std::string::npos)
+        {
+            std::cerr << "no port in " << address << std::endl;
+            return false;
+        }
+        const auto host = hostport.substr(0, colon);
+        const auto port = hostport.substr(colon + 1);
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo *found = nullptr;
+        const auto error = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found);
+        if (error != 0 || found == nullptr)
+        {
+            std::cerr << "cannot resolve " << address << ": " << gai_strerror(error) << std::endl;
+            return false;
+        }
+        out.family = found->ai_family;
+        out.length = found->ai_addrlen;
+        std::memcpy(&out.storage, found->ai_addr, found->ai_addrlen);
+        freeaddrinfo(found);
+        return true;
+    }
+
+    std::cerr << "expected unix:path or tcp:host:port, not " << address << std::endl;
+    return false;
+}
+
+// messages are small and answered at once, so they go out unbuffered
+static void configure(const int &fd, const int &family)
+{
+    if (family != AF_UNIX)
+    {
+        const int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+}
+
+// Connection
+
+Connection::Connection(const int &fd) : m_fd(fd) {}
+
+Connection::Connection(Connection &&other) : m_fd(std::exchange(other.m_fd, -1)) {}
+
+Connection &Connection::operator=(Connection &&other)
+{
+    if (this != &other)
+    {
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+        }
+        m_fd = std::exchange(other.m_fd, -1);
+    }
+    return *this;
+}
+
+Connection::~Connection()
+{
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+}
+
+static bool sendAll(const int &fd, const std::byte *data, size_t size)
+{
+    while (size > 0)
+    {
+        // a worker that has gone is an error, not a signal
+        const auto sent = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+static bool receiveAll(const int &fd, std::byte *data, size_t size)
+{
+    while (size > 0)
+    {
+        const auto received = ::recv(fd, data, size, 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+// the frame header: the message type, then the payload length
+struct Frame
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t length;
+};
+
+bool Connection::send(const Message &message)
+{
+    const Frame frame{static_cast<uint32_t>(message.m_type), 0, message.m_payload.size()};
+    return sendAll(m_fd, reinterpret_cast<const std::byte *>(&frame), sizeof(frame)) &&
+           sendAll(m_fd, message.m_payload.data(), message.m_payload.size());
+}
+
+bool Connection::receive(Message &message, const size_t &limit)
+{
+    Frame frame;
+    if (!receiveAll(m_fd, reinterpret_cast<std::byte *>(&frame), sizeof(frame)) ||
+        frame.type > static_cast<uint32_t>(MessageType::DONE) || frame.length > limit)
+    {
+        return false;
+    }
+    message.reset(static_cast<MessageType>(frame.type));
+    message.m_payload.resize(frame.length);
+    return receiveAll(m_fd, message.m_payload.data(), frame.length);
+}
+
+// Listener
+
+Listener::~Listener()
+{
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+    if (!m_path.empty())
+    {
+        unlink(m_path.c_str());
+    }
+}
+
+bool Listener::listen(const std::string &address)
+{
+    Address a;
+    if (!resolve(address, a))
+    {
+        return false;
+    }
+
+    m_fd = socket(a.family, SOCK_STREAM, 0);
+    if (m_fd < 0)
+    {
+        return false;
+    }
+    const int on = 1;
+    setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    // a socket file left by an earlier run would keep the bind from working
+    if (a.family == AF_UNIX)
+    {
+        unlink(a.path.c_str());
+        m_path = a.path;
+    }
+    return bind(m_fd, reinterpret_cast<const sockaddr *>(&a.storage), a.length) == 0 &&
+           ::listen(m_fd, SOMAXCONN) == 0;
+}
+
+Connection Listener::accept()
+{
+    sockaddr_storage peer;
+    socklen_t length = sizeof(peer);
+    const int fd = ::accept(m_fd, reinterpret_cast<sockaddr *>(&peer), &length);
+    if (fd >= 0)
+    {
+        configure(fd, peer.ss_family);
+    }
+    return Connection(fd);
+}
+
+Connection connectTo(const std::string &address, const int &timeout)
+{
+    Address a;
+    if (!resolve(address, a))
+    {
+        return Connection();
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+    while (true)
+    {
+        const int fd = socket(a.family, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            return Connection();
+        }
+        if (connect(fd, reinterpret_cast<const sockaddr *>(&a.storage), a.length) == 0)
+        {
+            configure(fd, a.family);
+            return Connection(fd);
+        }
+        close(fd);
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            return Connection();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
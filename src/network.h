@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Network
+//
+// A coordinator and its workers talk over stream sockets, Unix or TCP, in
+// framed messages: a type and a payload length, then the payload. Values
+// are copied as they are in memory, so every process must be the same
+// build on the same architecture; the workers say which they are first.
+// An address is unix:path or tcp:host:port.
+
+enum class MessageType : uint32_t
+{
+    // worker to coordinator: its connections per brain and Numeric size
+    HELLO,
+    // coordinator to worker: agents to run for a generation
+    WORK,
+    // worker to coordinator: the errors of those agents, in order
+    ERRORS,
+    // coordinator to worker: the run is over
+    DONE,
+};
+
+// A message is built by putting values in order, and read by getting them
+// in the same order; its payload is kept between messages, so that sending
+// a generation after the first does not allocate
+
+class Message
+{
+public:
+    // an empty message of type
+    void reset(const MessageType &type)
+    {
+        m_type = type;
+        m_payload.clear();
+        m_read = 0;
+        m_failed = false;
+    }
+
+    MessageType type() const
+    {
+        return m_type;
+    }
+
+    template <typename T>
+    void put(std::span<const T> values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto at = m_payload.size();
+        m_payload.resize(at + values.size_bytes());
+        std::memcpy(m_payload.data() + at, values.data(), values.size_bytes());
+    }
+
+    template <typename T>
+    void put(const T &value)
+    {
+        put(std::span<const T>(&value, 1));
+    }
+
+    // the next values; past the end of the payload, zeros, and the
+    // message is no longer valid
+    template <typename T>
+    void get(std::span<T> values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (m_failed || m_payload.size() - m_read < values.size_bytes())
+        {
+            m_failed = true;
+            std::memset(values.data(), 0, values.size_bytes());
+            return;
+        }
+        std::memcpy(values.data(), m_payload.data() + m_read, values.size_bytes());
+        m_read += values.size_bytes();
+    }
+
+    template <typename T>
+    T get()
+    {
+        T value;
+        get(std::span<T>(&value, 1));
+        return value;
+    }
+
+    // true if every value got was there, and nothing is left
+    bool valid() const
+    {
+        return !m_failed && m_read == m_payload.size();
+    }
+
+    // FNV-1a of the payload
+    uint64_t hash() const
+    {
+        uint64_t h = 0xcbf29ce484222325;
+        for (const auto &b : m_payload)
+        {
+            h = (h ^ static_cast<uint8_t>(b)) * 0x100000001b3;
+        }
+        return h;
+    }
+
+private:
+    friend class Connection;
+
+    MessageType m_type = MessageType::DONE;
+    std::vector<std::byte> m_payload;
+    size_t m_read = 0;
+    bool m_failed = false;
+};
+
+// A connection owns its socket, and closes it when destroyed
+
+class Connection
+{
+public:
+    Connection() = default;
+    explicit Connection(const int &fd);
+    Connection(Connection &&other);
+    Connection &operator=(Connection &&other);
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+    ~Connection();
+
+    bool connected() const
+    {
+        return m_fd >= 0;
+    }
+
+    // false if the peer has gone; a message with a payload over limit
+    // bytes is not read, and the connection is no use after it
+    bool send(const Message &message);
+    bool receive(Message &message, const size_t &limit);
+
+private:
+    int m_fd = -1;
+};
+
+// A listener accepts workers at an address; a Unix socket's file is
+// removed again when the listener is destroyed
+
+class Listener
+{
+public:
+    Listener() = default;
+    Listener(const Listener &) = delete;
+    Listener &operator=(const Listener &) = delete;
+    ~Listener();
+
+    // false if the address is malformed or cannot be bound
+    bool listen(const std::string &address);
+
+    // the next worker to connect; not connected on failure
+    Connection accept();
+
+private:
+    int m_fd = -1;
+    std::string m_path;
+};
+
+// a connection to the listener at address; a coordinator may still be
+// starting up, so connecting is retried for up to timeout seconds
+Connection connectTo(const std::string &address, const int &timeout);
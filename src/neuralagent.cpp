@@ -1,35 +1,79 @@
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "kernels.h"
 #include "neuralagent.h"
-#include "random.h"
 
-NeuralAgent::NeuralAgent() : Agent()
+NeuralAgent::NeuralAgent(PopulationStore &store, GenomePool &genomes, const size_t &index) : Agent(store, index), m_genomes(&genomes)
 {
+    const auto &config = getConfig();
+    m_updateType = config.NEURAL_UPDATE_TYPE;
+    m_brainType = config.NEURAL_BRAIN_TYPE;
+
     setupBrain();
 }
 
-NeuralAgent::NeuralAgent(const NeuralAgent::SP other) : Agent(other)
+void NeuralAgent::inherit(const NeuralAgent &other, RandomStream &rng)
 {
-    updateType(other->updateType());
-    brainType(other->brainType());
+    resetBrain(rng);
+
+    // copy the genome, record to record
+    const auto w = other.weights();
+    const auto d = other.m_genomes->deltas(other.index());
+    const auto e = other.enabled();
+    std::copy(w.begin(), w.end(), weights().begin());
+    std::copy(d.begin(), d.end(), weight_delta().begin());
+    std::copy(e.begin(), e.end(), enabled().begin());
+}
 
-    setupBrain();
+// Fitness relevance
+//
+// A sink is live if it writes agent state that the error function reads,
+// directly or through the sources or other live sinks; the rest, such as
+// colour and size when no source senses them, only matter when the agents
+// are drawn
+
+static std::vector<uint8_t> findLiveSinks(const std::vector<SourceKind> &sources, const std::vector<SinkKind> &sinks)
+{
+    AgentFields read = ERROR_FUNCTION_READS;
+    for (const auto &s : sources)
+    {
+        read |= sourceReads(s);
+    }
 
-    // copy brain weights
-    const auto &b = other->brain();
-    const auto &d = other->weight_delta();
-    // std::cout << "NA copy my brain = " << m_brain.size() << " other brain = " << b.size() << std::endl;
-    for (size_t i = 0; i < m_brain.size(); ++i)
+    std::vector<uint8_t> live(sinks.size(), 0);
+    for (bool changed = true; changed;)
     {
-        std::get<1>(m_brain[i]) = std::get<1>(b[i]);
-        m_weight_delta[i] = d[i];
+        changed = false;
+        for (size_t j = 0; j < sinks.size(); ++j)
+        {
+            if (!live[j] && (sinkWrites(sinks[j]) & read))
+            {
+                live[j] = 1;
+                read |= sinkReads(sinks[j]);
+                changed = true;
+            }
+        }
     }
+    return live;
 }
 
 // Update strategies
 
-void NeuralAgent::update(const size_t &iter)
+void NeuralAgent::update(const size_t &iter, const bool &sliced)
 {
     age(iter);
+    layoutBrain();
+    if (getConfig().NEURAL_COMPILED)
+    {
+        update_Compiled(sliced && m_topology->sliceable);
+        return;
+    }
     resetNeurons();
+    sense(&m_brains->compiled.values[m_brains->compiled.sourceIndex(0)]);
     switch (m_updateType)
     {
     case NeuralUpdateType::MAX:
@@ -42,7 +86,7 @@ void NeuralAgent::update(const size_t &iter)
         update_Every();
         break;
     }
-    applySinkValues();
+    applySinks(&m_brains->compiled.values[m_brains->compiled.sinkIndex(0)], false);
 }
 
 void NeuralAgent::update_Max()
@@ -51,10 +95,17 @@ void NeuralAgent::update_Max()
     int maxidx = -1;
 
     // calculate neuron activation values
-    for (size_t i = 0; i < m_brain.size(); ++i)
+    const auto &connections = m_topology->connections;
+    const auto weights = m_genomes->weights(index());
+    const auto enabled = m_genomes->enabled(index());
+    for (size_t i = 0; i < connections.size(); ++i)
     {
-        const auto &[src, w, snk] = m_brain[i];
-        const auto val = src->read(shared_from_this(), w) * w;
+        if (!enabled[i])
+        {
+            continue;
+        }
+        const auto &[src, snk] = connections[i];
+        const auto val = readNeuron(src) * weights[i];
         // std::cout << "w=" << w << " val=" << val << " maxval=" << maxval << std::endl;
         // find maximally activated sink
         const auto absval = std::abs(val);
@@ -65,10 +116,9 @@ void NeuralAgent::update_Max()
         }
     }
 
-    if (maxidx > -1 && maxidx < m_brain.size())
+    if (maxidx > -1 && maxidx < connections.size())
     {
-        const auto [src, w, snk] = m_brain[maxidx];
-        snk->write(w);
+        writeNeuron(connections[maxidx].second, weights[maxidx]);
     }
 }
 
@@ -76,14 +126,21 @@ void NeuralAgent::update_Threshold()
 {
     const auto &config = getConfig();
     // calculate neuron activation values
-    for (size_t i = 0; i < m_brain.size(); ++i)
+    const auto &connections = m_topology->connections;
+    const auto weights = m_genomes->weights(index());
+    const auto enabled = m_genomes->enabled(index());
+    for (size_t i = 0; i < connections.size(); ++i)
     {
-        const auto &[src, w, snk] = m_brain[i];
-        const auto val = src->read(shared_from_this(), w) * w;
+        if (!enabled[i])
+        {
+            continue;
+        }
+        const auto &[src, snk] = connections[i];
+        const auto val = readNeuron(src) * weights[i];
         // activate above threshold
         if (std::abs(val) > config.NEURAL_THRESHOLD)
         {
-            snk->write(val);
+            writeNeuron(snk, val);
         }
     }
 }
@@ -91,11 +148,87 @@ void NeuralAgent::update_Threshold()
 void NeuralAgent::update_Every()
 {
     // calculate neuron activation values
-    for (size_t i = 0; i < m_brain.size(); ++i)
+    const auto &connections = m_topology->connections;
+    const auto weights = m_genomes->weights(index());
+    const auto enabled = m_genomes->enabled(index());
+    for (size_t i = 0; i < connections.size(); ++i)
+    {
+        if (!enabled[i])
+        {
+            continue;
+        }
+        const auto &[src, snk] = connections[i];
+        const auto val = readNeuron(src) * weights[i];
+        writeNeuron(snk, val);
+    }
+}
+
+void NeuralAgent::update_Compiled(const bool &sliced)
+{
+    const auto &config = getConfig();
+    compile();
+
+    // incremental evaluation keeps the agent's brain from the previous
+    // tick, which a streamed agent does not have
+    const auto incremental = config.NEURAL_INCREMENTAL && !streamed();
+    auto &brain = sliced ? m_brains->sliced : m_brains->compiled;
+    brain.reset();
+    sense(&brain.values[brain.sourceIndex(0)]);
+
+    switch (m_updateType)
+    {
+    case NeuralUpdateType::MAX:
+        if (incremental && brain.update_IncrementalMax())
+        {
+            if (config.NEURAL_VERIFY_INCREMENTAL)
+            {
+                brain.verifyIncremental(true, config.NEURAL_THRESHOLD);
+            }
+            break;
+        }
+        brain.update_Max();
+        break;
+    case NeuralUpdateType::THRESHOLD:
+        if (incremental && brain.update_IncrementalThreshold(config.NEURAL_THRESHOLD))
+        {
+            if (config.NEURAL_VERIFY_INCREMENTAL)
+            {
+                brain.verifyIncremental(false, config.NEURAL_THRESHOLD);
+            }
+            break;
+        }
+        brain.update_Threshold(config.NEURAL_THRESHOLD);
+        break;
+    case NeuralUpdateType::EVERY:
+        brain.update_Every();
+        break;
+    }
+
+    applySinks(&brain.values[brain.sinkIndex(0)], sliced);
+}
+
+// Sensing stage; every source is sampled once per tick, not once per
+// connection, and the samples are written to the input vector
+
+void NeuralAgent::sense(Numeric *sources)
+{
+    const auto &kinds = m_topology->sources;
+    for (size_t i = 0; i < kinds.size(); ++i)
     {
-        const auto &[src, w, snk] = m_brain[i];
-        const auto val = src->read(shared_from_this(), w) * w;
-        snk->write(val);
+        sources[i] = senseSource(kinds[i], *this);
+    }
+}
+
+void NeuralAgent::applySinks(Numeric *sinks, const bool &sliced)
+{
+    // activate every sink at once, in place, then apply them in the order
+    // they first appear in the brain; a sliced brain holds the live sinks
+    // only, in the same order
+    const auto &kinds = sliced ? m_topology->liveSinkKinds : m_topology->sinks;
+    getKernels().sigmoid(sinks, sinks, kinds.size());
+    for (size_t j = 0; j < kinds.size(); ++j)
+    {
+        applySink(kinds[j], *this, sinks[j]);
     }
 }
 
@@ -103,58 +236,149 @@ void NeuralAgent::update_Every()
 
 void NeuralAgent::resetNeurons()
 {
-    for (size_t i = 0; i < m_brain.size(); ++i)
+    // sink and memory neurons live in the value array
+    m_brains->compiled.reset();
+}
+
+Numeric NeuralAgent::readNeuron(const size_t &i) const
+{
+    // sinks are never read
+    if (i < m_brains->compiled.sinkIndex(0))
     {
-        const auto &[src, w, snk] = m_brain[i];
-        src->reset();
-        snk->reset();
+        return m_brains->compiled.values[i];
     }
+    return readMemory(m_topology->memory[i - m_brains->compiled.memoryIndex(0)], m_brains->compiled.values[i]);
 }
 
-void NeuralAgent::applySinkValues()
+void NeuralAgent::writeNeuron(const size_t &i, const Numeric &weight)
 {
-    for (size_t i = 0; i < m_brain.size(); ++i)
+    if (i < m_brains->compiled.memoryIndex(0))
     {
-        const auto &[src, w, snk] = m_brain[i];
-        snk->apply(shared_from_this());
+        m_brains->compiled.values[i] += weight;
+        return;
     }
+    writeMemory(m_topology->memory[i - m_brains->compiled.memoryIndex(0)], m_brains->compiled.values[i], weight);
 }
 
-// Brain strategies
+// Brain topology
+
+BrainTopology::BrainTopology(const NeuralBrainType &brainType, const NeuralUpdateType &updateType)
+{
+    const auto &config = getConfig();
+
+    // Create sources and sinks; names were checked when parsing options
+    for (const auto &sourceName : config.NEURON_SOURCES)
+    {
+        sources.push_back(findSource(sourceName).value());
+    }
+    for (const auto &sinkName : config.NEURON_SINKS)
+    {
+        sinks.push_back(findSink(sinkName).value());
+    }
+
+    switch (brainType)
+    {
+    case NeuralBrainType::NO_MEMORY:
+        setup_no_memory();
+        break;
+    case NeuralBrainType::LAYERED:
+        setup_layered_memory();
+        break;
+    case NeuralBrainType::FULLY_CONNECTED:
+        setup_fully_connected_memory();
+        break;
+    }
 
-void NeuralAgent::setupBrain_no_memory()
+    // MAX picks one connection over all of them, dead sinks included, so
+    // its brains cannot be sliced
+    liveSinks = findLiveSinks(sources, sinks);
+    sliceable = config.NEURAL_SLICED &&
+                updateType != NeuralUpdateType::MAX &&
+                std::count(liveSinks.begin(), liveSinks.end(), 1) < (std::ptrdiff_t)sinks.size();
+    if (sliceable)
+    {
+        sliced.slice(compiled, liveSinks);
+        for (size_t j = 0; j < sinks.size(); ++j)
+        {
+            if (liveSinks[j])
+            {
+                liveSinkKinds.push_back(sinks[j]);
+            }
+        }
+        for (size_t i = 0; i < connections.size(); ++i)
+        {
+            const auto to = connections[i].second;
+            if (to < compiled.sinkIndex(0) || to >= compiled.memoryIndex(0) || liveSinks[to - compiled.sinkIndex(0)])
+            {
+                slicedConnections.push_back(i);
+            }
+        }
+    }
+}
+
+const BrainTopology &BrainTopology::get(const NeuralBrainType &brainType, const NeuralUpdateType &updateType)
 {
-    for (size_t i = 0; i < m_sources.size(); ++i)
+    // topologies live for the rest of the run
+    static std::mutex mutex;
+    static std::map<std::pair<NeuralBrainType, NeuralUpdateType>, std::unique_ptr<BrainTopology>> topologies;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &topology = topologies[{brainType, updateType}];
+    if (!topology)
     {
-        auto src = m_sources[i];
-        for (size_t j = 0; j < m_sinks.size(); ++j)
+        topology = std::make_unique<BrainTopology>(brainType, updateType);
+    }
+    return *topology;
+}
+
+
+void BrainTopology::setup_no_memory()
+{
+    compiled.clear(sources.size(), sinks.size(), 0);
+    compiled.addLayer(compiled.sourceIndex(0), sources.size(), compiled.sinkIndex(0), sinks.size());
+
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        const auto src = compiled.sourceIndex(i);
+        for (size_t j = 0; j < sinks.size(); ++j)
         {
-            auto snk = m_sinks[j];
-            BrainConnection c(src, 0.f, snk);
-            m_brain.push_back(c);
+            const auto snk = compiled.sinkIndex(j);
+            connections.emplace_back(src, snk);
         }
     }
 }
 
-void NeuralAgent::setupBrain_layered_memory()
+void BrainTopology::setup_layered_memory()
 {
     const auto &config = getConfig();
     for (size_t i = 0; i < config.NUM_MEMORY_LAYERS * config.NUM_MEMORY_PER_LAYER; ++i)
     {
-        m_memory.push_back(std::make_shared<SummingSigmoidMemoryNeuron>());
+        memory.push_back(MemoryKind::SUMMING_SIGMOID);
+    }
+    // std::cout << " total mem neurons " << memory.size() << std::endl;
+
+    const auto K = config.NUM_MEMORY_PER_LAYER;
+    compiled.clear(sources.size(), sinks.size(), memory.size());
+    compiled.addLayer(compiled.sourceIndex(0), sources.size(), compiled.memoryIndex(0), K);
+    for (size_t w = 0; w < config.NUM_MEMORY_LAYERS - 1; ++w)
+    {
+        compiled.addLayer(compiled.memoryIndex(w * K), K, compiled.memoryIndex((w + 1) * K), K);
+    }
+    compiled.addLayer(compiled.memoryIndex((config.NUM_MEMORY_LAYERS - 1) * K), K, compiled.sinkIndex(0), sinks.size());
+    if (config.NEURAL_SPECIALIZED)
+    {
+        compiled.specialized = findLayeredKernel(config.NUM_MEMORY_LAYERS, K);
     }
-    // std::cout << " total mem neurons " << m_memory.size() << std::endl;
 
     // connect every source to every memory neuron in the first layer
-    for (size_t i = 0; i < m_sources.size(); ++i)
+    for (size_t i = 0; i < sources.size(); ++i)
     {
-        auto src = m_sources[i];
+        const auto src = compiled.sourceIndex(i);
         for (size_t j = 0; j < config.NUM_MEMORY_PER_LAYER; ++j)
         {
-            auto m = m_memory[j];
+            const auto m = compiled.memoryIndex(j);
             // std::cout << " connect src " << i << " to mem " << j << std::endl;
-            BrainConnection c(src, 0.f, m);
-            m_brain.push_back(c);
+            connections.emplace_back(src, m);
         }
     }
 
@@ -166,14 +390,13 @@ void NeuralAgent::setupBrain_layered_memory()
         for (size_t i = 0; i < config.NUM_MEMORY_PER_LAYER; ++i)
         {
             const auto im1 = i + (w * config.NUM_MEMORY_PER_LAYER);
-            auto m1 = m_memory[im1];
+            const auto m1 = compiled.memoryIndex(im1);
             for (size_t j = 0; j < config.NUM_MEMORY_PER_LAYER; ++j)
             {
                 const auto im2 = j + ((w + 1) * config.NUM_MEMORY_PER_LAYER);
-                auto m2 = m_memory[im2];
+                const auto m2 = compiled.memoryIndex(im2);
                 // std::cout << " connect mem " << im1 << " to mem " << im2 << std::endl;
-                BrainConnection c(m1, 0.f, m2);
-                m_brain.push_back(c);
+                connections.emplace_back(m1, m2);
             }
         }
     }
@@ -182,121 +405,179 @@ void NeuralAgent::setupBrain_layered_memory()
     for (size_t i = 0; i < config.NUM_MEMORY_PER_LAYER; ++i)
     {
         const auto im = i + ((config.NUM_MEMORY_LAYERS - 1) * config.NUM_MEMORY_PER_LAYER);
-        auto m = m_memory[im];
-        for (size_t j = 0; j < m_sinks.size(); ++j)
+        const auto m = compiled.memoryIndex(im);
+        for (size_t j = 0; j < sinks.size(); ++j)
         {
-            auto snk = m_sinks[j];
+            const auto snk = compiled.sinkIndex(j);
             // std::cout << " connect mem " << im << " to sink " << j << std::endl;
-            BrainConnection c(m, 0.f, snk);
-            m_brain.push_back(c);
+            connections.emplace_back(m, snk);
         }
     }
 }
 
-void NeuralAgent::setupBrain_fully_connected_memory()
+void BrainTopology::setup_fully_connected_memory()
 {
     const auto &config = getConfig();
     for (size_t i = 0; i < config.NUM_MEMORY_LAYERS * config.NUM_MEMORY_PER_LAYER; ++i)
     {
-        m_memory.push_back(std::make_shared<SummingSigmoidMemoryNeuron>());
+        memory.push_back(MemoryKind::SUMMING_SIGMOID);
     }
 
+    // sinks and memory are adjacent, so each source row covers both
+    compiled.clear(sources.size(), sinks.size(), memory.size());
+    compiled.addLayer(compiled.sourceIndex(0), sources.size(), compiled.sinkIndex(0), sinks.size() + memory.size());
+    compiled.addLayer(compiled.memoryIndex(0), memory.size(), compiled.memoryIndex(0), memory.size());
+    compiled.addLayer(compiled.memoryIndex(0), memory.size(), compiled.sinkIndex(0), sinks.size());
+
     // the order of connection is important;
     // we want to perform all memory writes
     // before any memory reads
 
-    for (size_t i = 0; i < m_sources.size(); ++i)
+    for (size_t i = 0; i < sources.size(); ++i)
     {
-        auto src = m_sources[i];
+        const auto src = compiled.sourceIndex(i);
         // connect all sources and sinks
-        for (size_t j = 0; j < m_sinks.size(); ++j)
+        for (size_t j = 0; j < sinks.size(); ++j)
         {
-            auto snk = m_sinks[j];
-            BrainConnection c(src, 0.f, snk);
-            m_brain.push_back(c);
+            const auto snk = compiled.sinkIndex(j);
+            connections.emplace_back(src, snk);
         }
         // connect every source to every memory neuron
-        for (size_t k = 0; k < m_memory.size(); ++k)
+        for (size_t k = 0; k < memory.size(); ++k)
         {
-            auto m = m_memory[k];
-            BrainConnection c(src, 0.f, m);
-            m_brain.push_back(c);
+            const auto m = compiled.memoryIndex(k);
+            connections.emplace_back(src, m);
         }
     }
 
     // connect all memory neurons together;
     // this is both read and write on memory;
     // is this consistent?
-    for (size_t i = 0; i < m_memory.size(); ++i)
+    for (size_t i = 0; i < memory.size(); ++i)
     {
-        for (size_t j = 0; j < m_memory.size(); ++j)
+        for (size_t j = 0; j < memory.size(); ++j)
         {
-            auto m1 = m_memory[i];
-            auto m2 = m_memory[j];
-            BrainConnection c1(m1, 0.f, m2);
-            m_brain.push_back(c1);
+            const auto m1 = compiled.memoryIndex(i);
+            const auto m2 = compiled.memoryIndex(j);
+            connections.emplace_back(m1, m2);
         }
     }
 
     // connect all memory neurons to all sinks
-    for (size_t i = 0; i < m_memory.size(); ++i)
+    for (size_t i = 0; i < memory.size(); ++i)
     {
-        auto m = m_memory[i];
-        for (size_t j = 0; j < m_sinks.size(); ++j)
+        const auto m = compiled.memoryIndex(i);
+        for (size_t j = 0; j < sinks.size(); ++j)
         {
-            auto snk = m_sinks[j];
-            BrainConnection c(m, 0.f, snk);
-            m_brain.push_back(c);
+            const auto snk = compiled.sinkIndex(j);
+            connections.emplace_back(m, snk);
         }
     }
 }
 
+// Brain strategies
+
 void NeuralAgent::setupBrain()
 {
-    const auto &config = getConfig();
+    m_topology = &BrainTopology::get(m_brainType, m_updateType);
+    m_compiledStale = true;
+}
 
-    m_brain.clear();
-    m_sources.clear();
-    m_sinks.clear();
-    m_memory.clear();
+void NeuralAgent::layoutBrain()
+{
+    // a streamed genome is compiled afresh into the updating thread's
+    // brains, so that no agent keeps a copy of its weights in memory;
+    // otherwise the agent's own brains are allocated on first use. Laying
+    // brains out again reuses their storage.
+    if (streamed())
+    {
+        thread_local Brains scratch;
+        m_brains = &scratch;
+        m_compiledStale = true;
+    }
+    else
+    {
+        if (!m_ownBrains)
+        {
+            m_ownBrains = std::make_unique<Brains>();
+        }
+        m_brains = m_ownBrains.get();
+    }
 
-    const auto &sourceRegistry = getSources();
-    const auto &sinkRegistry = getSinks();
+    if (m_brains->topology == m_topology)
+    {
+        return;
+    }
+    m_brains->compiled = m_topology->compiled;
+    if (m_topology->sliceable)
+    {
+        m_brains->sliced = m_topology->sliced;
+    }
+    m_brains->topology = m_topology;
+}
 
-    // Create sources and sinks
-    std::vector<Neuron::SP> sources;
-    for (const auto &sourceName : config.NEURON_SOURCES)
+void NeuralAgent::resetBrain(RandomStream &rng)
+{
+    // a chunk of variates at a time
+    std::array<Numeric, 256> u;
+    const auto deltas = weight_delta();
+    for (size_t j = 0; j < deltas.size(); ++j)
     {
-        auto sf = sourceRegistry.at(sourceName);
-        sources.push_back(sf());
+        if (j % u.size() == 0)
+        {
+            rng.uniform(std::span(u).first(std::min(u.size(), deltas.size() - j)));
+        }
+        deltas[j] = u[j % u.size()] > 0.5 ? 1 : -1;
     }
-    m_sources.swap(sources);
+    const auto e = enabled();
+    std::fill(e.begin(), e.end(), 1);
 
-    std::vector<Neuron::SP> sinks;
-    for (const auto &sourceName : config.NEURON_SINKS)
+    m_compiledStale = true;
+}
+
+void NeuralAgent::compileWeights()
+{
+    layoutBrain();
+
+    // the compiled layers are laid out in connection order; quantizing
+    // clears the compiled weights, so they may need resizing
+    const auto weights = m_genomes->weights(index());
+    const auto enabled = m_genomes->enabled(index());
+    auto &compiled = m_brains->compiled;
+    compiled.weights.resize(weights.size());
+    for (size_t i = 0; i < weights.size(); ++i)
     {
-        auto sf = sinkRegistry.at(sourceName);
-        sinks.push_back(sf());
+        compiled.weights[i] = enabled[i] ? weights[i] : 0;
     }
-    m_sinks.swap(sinks);
+    compileLayers(compiled, enabled.data(), nullptr);
 
-    switch (m_brainType)
+    // and the sliced ones the same, less the connections into dead sinks
+    if (m_topology->sliceable)
     {
-    case NeuralBrainType::NO_MEMORY:
-        setupBrain_no_memory();
-        break;
-    case NeuralBrainType::LAYERED:
-        setupBrain_layered_memory();
-        break;
-    case NeuralBrainType::FULLY_CONNECTED:
-        setupBrain_fully_connected_memory();
-        break;
+        const auto &kept = m_topology->slicedConnections;
+        auto &sliced = m_brains->sliced;
+        auto &slicedEnabled = m_brains->slicedEnabled;
+        sliced.weights.resize(kept.size());
+        slicedEnabled.resize(kept.size());
+        for (size_t k = 0; k < kept.size(); ++k)
+        {
+            const auto i = kept[k];
+            sliced.weights[k] = enabled[i] ? weights[i] : 0;
+            slicedEnabled[k] = enabled[i];
+        }
+        compileLayers(sliced, slicedEnabled.data(), &compiled);
     }
 
-    m_weight_delta.clear();
-    m_weight_delta.resize(m_brain.size());
-    for (size_t i = 0; i < m_brain.size(); ++i)
+    m_compiledStale = false;
+}
+
+void NeuralAgent::compileLayers(CompiledBrain &brain, const uint8_t *enabled, const CompiledBrain *full)
+{
+    const auto &config = getConfig();
+    brain.compileSparse(enabled, config.NEURAL_SPARSE_DENSITY);
+    if (config.NEURAL_QUANTIZE_BITS != 0 && m_updateType == NeuralUpdateType::EVERY)
     {
-        m_weight_delta[i] = randf() > 0.5 ? 1 : -1;
+        brain.compileQuantized(config.NEURAL_QUANTIZE_BITS, full);
     }
+    brain.primed = false;
 }
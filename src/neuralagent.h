@@ -2,108 +2,178 @@
 
 #include <cmath>
 #include <memory>
-#include <tuple>
+#include <span>
+#include <utility>
 #include <vector>
 
 #include "agent.h"
+#include "brain.h"
+#include "genome.h"
 #include "neuron.h"
+#include "random.h"
 #include "sources.h"
 #include "sinks.h"
 
-// Special Neurons
+// Brain
+
+// connections are (from, to), by index in the compiled value array
+using BrainConnection = std::pair<size_t, size_t>;
 
-class SummingMemoryNeuron : public Neuron
+// Brain topology
+//
+// The connections, neuron kinds and compiled layout of a brain depend only
+// on its brain and update types and the configuration, so they are built
+// once per run and shared, read only, by every agent of those types. An
+// agent owns only its genome: a weight, a mutation direction and an enable
+// flag per connection, in connection order.
+
+struct BrainTopology
 {
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        return m_val;
-    };
-    virtual void write(const Numeric &weight)
-    {
-        m_val += weight;
-    };
-    virtual void reset()
-    {
-        m_val = 0;
-    };
+    BrainTopology(const NeuralBrainType &brainType, const NeuralUpdateType &updateType);
+
+    // the topology for these types, built on first use
+    static const BrainTopology &get(const NeuralBrainType &brainType, const NeuralUpdateType &updateType);
+
+    std::vector<BrainConnection> connections;
+    std::vector<SourceKind> sources;
+    std::vector<SinkKind> sinks;
+    std::vector<MemoryKind> memory;
+
+    // layouts for the agents' compiled brains, with zero weights
+    CompiledBrain compiled;
+    CompiledBrain sliced;
+
+    // 1 for each sink that can affect the error function, and those sinks
+    std::vector<uint8_t> liveSinks;
+    std::vector<SinkKind> liveSinkKinds;
+    // the connections kept in the sliced brain, in connection order
+    std::vector<size_t> slicedConnections;
+    bool sliceable = false;
 
 private:
-    Numeric m_val;
+    void setup_no_memory();
+    void setup_layered_memory();
+    void setup_fully_connected_memory();
 };
 
-class SummingSigmoidMemoryNeuron : public Neuron
+// Agent
+
+class NeuralAgent : public Agent
 {
 public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
+    // an agent with the configured brain, in slot index of store and of
+    // genomes, which must have room for its connections; its weights are
+    // zero until the brain is reset and given weights
+    NeuralAgent(PopulationStore &store, GenomePool &genomes, const size_t &index);
+
+    // draw new mutation directions from rng and enable every connection, in
+    // place
+    void resetBrain(RandomStream &rng);
+
+    // overwrite this genome with a copy of other's, in place, drawing from
+    // rng as resetBrain does; other has the same brain, as every agent of a
+    // population does. The agent's state is left to the caller.
+    void inherit(const NeuralAgent &other, RandomStream &rng);
+
+    // Genome, in this agent's record of its genome pool
+
+    std::span<Numeric> weights()
     {
-        return sigmoid(m_val);
-    };
-    virtual void write(const Numeric &weight)
+        // weights may be modified through this span
+        m_compiledStale = true;
+        return m_genomes->weights(index());
+    }
+
+    std::span<const Numeric> weights() const
     {
-        m_val += weight;
-    };
-    virtual void reset()
+        return m_genomes->weights(index());
+    }
+
+    std::span<int8_t> weight_delta()
     {
-        m_val = 0;
-    };
+        return m_genomes->deltas(index());
+    }
 
-private:
-    Numeric m_val;
-};
+    // connection enable mask; disabled connections are skipped entirely
+    std::span<uint8_t> enabled()
+    {
+        m_compiledStale = true;
+        return m_genomes->enabled(index());
+    }
 
-class MaxMemoryNeuron : public Neuron
-{
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
+    std::span<const uint8_t> enabled() const
     {
-        return m_val;
-    };
-    virtual void write(const Numeric &weight)
+        return m_genomes->enabled(index());
+    }
+
+    // the pool the genome is in, as record index()
+    GenomePool &genomes() const
     {
-        m_val = std::abs(weight) > std::abs(m_val) ? weight : m_val;
-    };
-    virtual void reset()
+        return *m_genomes;
+    }
+
+    // true if the genome is streamed from a mapped pool; the agent then
+    // keeps no compiled brain between updates
+    bool streamed() const
     {
-        m_val = 0;
-    };
+        return m_genomes->mapped();
+    }
 
-private:
-    Numeric m_val;
-};
+    const BrainTopology &topology() const
+    {
+        return *m_topology;
+    }
 
-// Brain
+    // sliced: only the sinks that can affect the error function need to
+    // act, as nothing is drawn after this update
+    void update(const size_t &iter, const bool &sliced);
 
-using BrainConnection = std::tuple<Neuron::SP, Numeric, Neuron::SP>;
-using Brain = std::vector<BrainConnection>;
+    // Compiled brain
 
-// Agent
+    void compile()
+    {
+        if (m_compiledStale)
+        {
+            compileWeights();
+        }
+    }
 
-class NeuralAgent : public Agent
-{
-public:
-    using SP = std::shared_ptr<NeuralAgent>;
+    // only valid after compile(), unless streamed()
+    const CompiledBrain &compiled() const
+    {
+        return m_brains->compiled;
+    }
 
-    NeuralAgent();
+    // the compiled brain without the sinks that cannot affect the error
+    // function; only valid after compile(), if sliceable()
+    const CompiledBrain &sliced() const
+    {
+        return m_brains->sliced;
+    }
 
-    NeuralAgent(const NeuralAgent::SP other);
+    bool sliceable() const
+    {
+        return m_topology->sliceable;
+    }
 
-    Brain &brain()
+    // 1 for each sink that can affect the error function
+    const std::vector<uint8_t> &liveSinks() const
     {
-        return m_brain;
+        return m_topology->liveSinks;
     }
 
-    const Brain &brain() const
+    const std::vector<SourceKind> &sources() const
     {
-        return m_brain;
+        return m_topology->sources;
     }
 
-    std::vector<Numeric> &weight_delta()
+    const std::vector<SinkKind> &sinks() const
     {
-        return m_weight_delta;
+        return m_topology->sinks;
     }
 
-    void update(const size_t &iter);
+    void sense(Numeric *sources);
+    void applySinks(Numeric *sinks, const bool &sliced);
 
     void updateType(const NeuralUpdateType &next)
     {
@@ -131,25 +201,39 @@ private:
     void update_Max();
     void update_Threshold();
     void update_Every();
+    void update_Compiled(const bool &sliced);
 
     // Neuron management
 
     void resetNeurons();
-    void applySinkValues();
+    Numeric readNeuron(const size_t &i) const;
+    void writeNeuron(const size_t &i, const Numeric &weight);
 
     // Brain strategies
 
-    void setupBrain_no_memory();
-    void setupBrain_layered_memory();
-    void setupBrain_fully_connected_memory();
     void setupBrain();
+    void layoutBrain();
+    void compileWeights();
+    void compileLayers(CompiledBrain &brain, const uint8_t *enabled, const CompiledBrain *full);
 
 private:
-    Brain m_brain;
-    std::vector<Numeric> m_weight_delta;
+    // the compiled brains, and the sliced one's enable mask, as laid out for
+    // topology
+    struct Brains
+    {
+        const BrainTopology *topology = nullptr;
+        CompiledBrain compiled;
+        CompiledBrain sliced;
+        std::vector<uint8_t> slicedEnabled;
+    };
+
+    GenomePool *m_genomes;
+    const BrainTopology *m_topology = nullptr;
     NeuralUpdateType m_updateType = NeuralUpdateType::EVERY;
     NeuralBrainType m_brainType = NeuralBrainType::LAYERED;
-    std::vector<Neuron::SP> m_sources;
-    std::vector<Neuron::SP> m_sinks;
-    std::vector<Neuron::SP> m_memory;
+    // this agent's own brains, allocated on first use, or while streamed,
+    // the brains of the thread updating it
+    std::unique_ptr<Brains> m_ownBrains;
+    Brains *m_brains = nullptr;
+    bool m_compiledStale = true;
 };
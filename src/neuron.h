@@ -1,24 +1,73 @@
 #pragma once
 
-#include <functional>
-#include <memory>
-#include <unordered_map>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
 
 #include "config.h"
 #include "agent.h"
 
-class Neuron
+// Neurons
+//
+// A neuron is an index into the brain's value array, [sources | sinks |
+// memory]; what it senses, applies or remembers is given by its kind, one
+// of a closed set per region, and dispatched with a switch. Sources and
+// sinks are named on the command line; the name tables are constexpr.
+
+template <typename Kind, size_t N>
+using NeuronNames = std::array<std::pair<std::string_view, Kind>, N>;
+
+template <typename Kind, size_t N>
+constexpr std::optional<Kind> findNeuron(const NeuronNames<Kind, N> &names, const std::string_view &name)
 {
-public:
-    using SP = std::shared_ptr<Neuron>;
+    for (const auto &[n, kind] : names)
+    {
+        if (n == name)
+        {
+            return kind;
+        }
+    }
+    return std::nullopt;
+}
 
-    virtual const Numeric read(Agent::SP a, const Numeric &weight) { return 0.0; };
-    virtual void write(const Numeric &weight){};
-    virtual void reset(){};
-    virtual void apply(Agent::SP a){};
-};
+// Memory neurons keep their value in the brain's value array, which is
+// cleared in bulk at the start of every update
 
-using NeuronFactory = std::function<Neuron::SP()>;
-using NeuronRegistry = std::unordered_map<std::string, NeuronFactory>;
+enum class MemoryKind : uint8_t
+{
+    SUMMING,
+    SUMMING_SIGMOID,
+    MAX,
+};
 
 Numeric sigmoid(const Numeric &x);
+
+inline Numeric readMemory(const MemoryKind &kind, const Numeric &value)
+{
+    switch (kind)
+    {
+    case MemoryKind::SUMMING_SIGMOID:
+        return sigmoid(value);
+    case MemoryKind::SUMMING:
+    case MemoryKind::MAX:
+        break;
+    }
+    return value;
+}
+
+inline void writeMemory(const MemoryKind &kind, Numeric &value, const Numeric &weight)
+{
+    switch (kind)
+    {
+    case MemoryKind::SUMMING:
+    case MemoryKind::SUMMING_SIGMOID:
+        value += weight;
+        break;
+    case MemoryKind::MAX:
+        value = std::abs(weight) > std::abs(value) ? weight : value;
+        break;
+    }
+}
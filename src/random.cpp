@@ -1,22 +1,139 @@
-#include "random.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <vector>
 
-#include <random>
+#include "random.h"
+#include "kernels.h"
 
-std::default_random_engine randengine;
+static std::array<uint32_t, 2> randkey = {0, 0};
 
 void random_seed(const int64_t seed)
 {
-    randengine.seed(seed);
+    const auto s = static_cast<uint64_t>(seed);
+    randkey = {static_cast<uint32_t>(s), static_cast<uint32_t>(s >> 32)};
+}
+
+RandomStream::RandomStream(const RandomUse &use, const uint64_t &generation, const uint64_t &index, const uint32_t &island)
+    : m_key(randkey),
+      m_counter{0, static_cast<uint32_t>(index), static_cast<uint32_t>(generation), static_cast<uint32_t>(use) | (island << 8)},
+      m_block{},
+      m_used(m_block.size())
+{
+}
+
+void RandomStream::refill()
+{
+    getKernels().philox(m_counter.data(), m_key.data(), m_block.data(), BUFFER_BLOCKS);
+    m_counter[0] += BUFFER_BLOCKS;
+    m_used = 0;
+}
+
+// the rest of the buffered block, then whole blocks straight from the
+// kernels a chunk at a time, then single draws for the tail
+template <typename Convert>
+void RandomStream::fill(std::span<Numeric> out, const Convert &convert)
+{
+    constexpr size_t CHUNK_BLOCKS = 64;
+    uint32_t chunk[4 * CHUNK_BLOCKS];
+    const auto &kernels = getKernels();
+
+    size_t i = 0;
+    for (; i < out.size() && m_used < m_block.size(); ++i)
+    {
+        out[i] = convert(m_block[m_used++]);
+    }
+    while (out.size() - i >= 4)
+    {
+        const auto blocks = std::min(CHUNK_BLOCKS, (out.size() - i) / 4);
+        kernels.philox(m_counter.data(), m_key.data(), chunk, blocks);
+        m_counter[0] += blocks;
+        for (size_t w = 0; w < blocks * 4; ++w)
+        {
+            out[i + w] = convert(chunk[w]);
+        }
+        i += blocks * 4;
+    }
+    for (; i < out.size(); ++i)
+    {
+        out[i] = convert(next());
+    }
+}
+
+void RandomStream::uniform(std::span<Numeric> out)
+{
+    fill(out, [](const uint32_t &w)
+         { return uniform(w); });
 }
 
-std::uniform_real_distribution<Numeric> randdist(0.0, 1.0);
-const Numeric randf()
+void RandomStream::bipolar(std::span<Numeric> out)
 {
-    return randdist(randengine);
+    fill(out, [](const uint32_t &w)
+         { return (2 * uniform(w)) - 1; });
 }
 
-std::uniform_real_distribution<Numeric> bipolarranddist(-1.0, 1.0);
-const Numeric bipolarrandf()
+void RandomStream::normal(std::span<Numeric> out)
 {
-    return bipolarranddist(randengine);
+    const auto pairs = out.size() / 2;
+    uniform(out.first(pairs * 2));
+    for (size_t i = 0; i < pairs * 2; i += 2)
+    {
+        // 1 - u is in (0, 1], so the log is finite
+        const auto r = std::sqrt(-2 * std::log(1 - out[i]));
+        const auto theta = TWOPI * out[i + 1];
+        out[i] = r * std::cos(theta);
+        out[i + 1] = r * std::sin(theta);
+    }
+    if (out.size() % 2 != 0)
+    {
+        const auto u = randf();
+        const auto v = randf();
+        out.back() = std::sqrt(-2 * std::log(1 - u)) * std::cos(TWOPI * v);
+    }
+}
+
+void benchmarkRandom()
+{
+    using clock = std::chrono::steady_clock;
+    constexpr size_t streams = 1000;
+    constexpr size_t draws = 100000;
+    std::vector<Numeric> out(draws);
+
+    const auto rate = [&](const char *name, const auto &draw)
+    {
+        const auto start = clock::now();
+        Numeric sum = 0;
+        for (size_t s = 0; s < streams; ++s)
+        {
+            RandomStream rng(RandomUse::BREEDING, 0, s);
+            sum += draw(rng);
+        }
+        const std::chrono::duration<double> elapsed = clock::now() - start;
+        // the sum keeps the draws from being optimized away
+        std::cout << name << ": " << (streams * draws) / elapsed.count() / 1e6 << "M variates/s (mean " << sum / (streams * draws) << ")" << std::endl;
+    };
+
+    std::cout << "random variates, " << getKernels().name << " kernels" << std::endl;
+    rate("single uniform", [&](RandomStream &rng)
+         {
+             Numeric sum = 0;
+             for (size_t i = 0; i < draws; ++i)
+             {
+                 sum += rng.randf();
+             }
+             return sum; });
+    rate("bulk uniform", [&](RandomStream &rng)
+         {
+             rng.uniform(out);
+             return std::accumulate(out.begin(), out.end(), Numeric(0)); });
+    rate("bulk bipolar", [&](RandomStream &rng)
+         {
+             rng.bipolar(out);
+             return std::accumulate(out.begin(), out.end(), Numeric(0)); });
+    rate("bulk normal", [&](RandomStream &rng)
+         {
+             rng.normal(out);
+             return std::accumulate(out.begin(), out.end(), Numeric(0)); });
 }
@@ -1,7 +1,129 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <span>
+
 #include "config.h"
 
 void random_seed(const int64_t seed);
-const Numeric randf();
-const Numeric bipolarrandf();
+
+// Random Streams
+//
+// Every agent draws from its own stream, keyed by what it draws for, the
+// generation and its index, so that agents can be set up and bred on any
+// thread, in any order, and a seed gives the same run whatever the number
+// of threads. The generator is counter-based, Philox4x32-10: the seed is
+// the key, and each block of four words is a pure function of the key and
+// the counter [draw block | index | generation | island, use], so a stream
+// keeps no state beyond its position and streams cannot overlap. The index
+// and generation are taken modulo 2^32, and the island modulo 2^24.
+//
+// Blocks come from the vector kernels. The bulk fills take whole runs of
+// blocks at once, and give what the same number of single draws would, so
+// the two can be mixed freely.
+
+enum class RandomUse : uint32_t
+{
+    INITIAL_POPULATION,
+    BREEDING,
+    SELECTION,
+};
+
+class RandomStream
+{
+public:
+    RandomStream(const RandomUse &use, const uint64_t &generation, const uint64_t &index, const uint32_t &island = 0);
+
+    // uniform in [0, 1), from one word; a double has 2^-32 resolution,
+    // which is plenty for initial conditions and mutation
+    Numeric randf()
+    {
+        return uniform(next());
+    }
+
+    // uniform in [-1, 1)
+    Numeric bipolarrandf()
+    {
+        return (2 * randf()) - 1;
+    }
+
+    // uniform in [0, n), n > 0, without bias: by multiply and shift, with
+    // Lemire's rejection of the few products that would favour some
+    // results; one word a try, or two when n is above 2^32
+    size_t below(const size_t &n)
+    {
+        if (n <= (uint64_t(1) << 32))
+        {
+            auto m = static_cast<uint64_t>(next()) * n;
+            if (static_cast<uint32_t>(m) < n)
+            {
+                const auto t = ((uint64_t(1) << 32) - n) % n;
+                while (static_cast<uint32_t>(m) < t)
+                {
+                    m = static_cast<uint64_t>(next()) * n;
+                }
+            }
+            return m >> 32;
+        }
+
+        const auto word = [this]()
+        {
+            const uint64_t hi = next();
+            return (hi << 32) | next();
+        };
+        auto m = static_cast<unsigned __int128>(word()) * n;
+        if (static_cast<uint64_t>(m) < n)
+        {
+            const auto t = (0 - static_cast<uint64_t>(n)) % n;
+            while (static_cast<uint64_t>(m) < t)
+            {
+                m = static_cast<unsigned __int128>(word()) * n;
+            }
+        }
+        return m >> 64;
+    }
+
+    // out[i] = randf(), or bipolarrandf(), in order
+    void uniform(std::span<Numeric> out);
+    void bipolar(std::span<Numeric> out);
+
+    // standard normal, by the Box-Muller transform of pairs of uniforms;
+    // takes two words for every two variates, or part of
+    void normal(std::span<Numeric> out);
+
+private:
+    static Numeric uniform(const uint32_t &word)
+    {
+#ifdef FEATURE_SINGLE_PRECISION
+        return (word >> 8) * 0x1.0p-24f;
+#else
+        return word * 0x1.0p-32;
+#endif // FEATURE_SINGLE_PRECISION
+    }
+
+    uint32_t next()
+    {
+        if (m_used == m_block.size())
+        {
+            refill();
+        }
+        return m_block[m_used++];
+    }
+
+    void refill();
+
+    template <typename Convert>
+    void fill(std::span<Numeric> out, const Convert &convert);
+
+    // single draws are buffered a vector group of blocks at a time
+    static constexpr size_t BUFFER_BLOCKS = 16;
+
+    std::array<uint32_t, 2> m_key;
+    std::array<uint32_t, 4> m_counter;
+    std::array<uint32_t, 4 * BUFFER_BLOCKS> m_block;
+    size_t m_used;
+};
+
+// report single and bulk variates per second with the selected kernels
+void benchmarkRandom();
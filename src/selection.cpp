@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "selection.h"
+#include "random.h"
+
+// a lower error wins; ties go to the lower index, so that every strategy
+// picks the same agents however they are ordered
+static bool better(const std::vector<Numeric> &errors, const size_t &a, const size_t &b)
+{
+    return errors[a] < errors[b] || (errors[a] == errors[b] && a < b);
+}
+
+Numeric Selection::select(const std::vector<Numeric> &errors, const Numeric &minError, const Numeric &maxError, const size_t &generation, const uint32_t &island, std::vector<size_t> &survivors)
+{
+    const auto &config = getConfig();
+    switch (config.SELECTION_TYPE)
+    {
+    case SelectionType::THRESHOLD:
+        return threshold(errors, minError, maxError, survivors);
+    case SelectionType::TOP_K:
+        return topK(errors, survivors);
+    case SelectionType::TOURNAMENT:
+        return tournament(errors, generation, island, survivors);
+    case SelectionType::RANK:
+        return rank(errors, generation, island, survivors);
+    }
+    return maxError;
+}
+
+Numeric Selection::threshold(const std::vector<Numeric> &errors, const Numeric &minError, const Numeric &maxError, std::vector<size_t> &survivors)
+{
+    const Numeric threshold = ((maxError - minError) * 0.008) + minError;
+
+    constexpr size_t BLOCK_SIZE = SELECTION_BLOCK_SIZE;
+    const size_t numBlocks = (errors.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    auto &counts = m_counts;
+    counts.resize(numBlocks + 1);
+
+#pragma omp parallel for
+    for (size_t b = 0; b < numBlocks; ++b)
+    {
+        const auto end = std::min(errors.size(), (b + 1) * BLOCK_SIZE);
+        counts[b + 1] = std::count_if(errors.begin() + (b * BLOCK_SIZE), errors.begin() + end, [&](const auto &e)
+                                      { return e < threshold; });
+    }
+    counts[0] = 0;
+    std::partial_sum(counts.begin(), counts.end(), counts.begin());
+
+    survivors.resize(counts[numBlocks]);
+#pragma omp parallel for
+    for (size_t b = 0; b < numBlocks; ++b)
+    {
+        auto out = counts[b];
+        const auto end = std::min(errors.size(), (b + 1) * BLOCK_SIZE);
+        for (size_t i = b * BLOCK_SIZE; i < end; ++i)
+        {
+            if (errors[i] < threshold)
+            {
+                survivors[out++] = i;
+            }
+        }
+    }
+
+    m_parents = survivors.size();
+    return threshold;
+}
+
+Numeric Selection::topK(const std::vector<Numeric> &errors, std::vector<size_t> &survivors)
+{
+    const auto k = best(errors.size());
+    partitionBest(errors, k);
+    survivors.assign(m_order.begin(), m_order.begin() + k);
+
+    m_parents = k;
+    return errors[m_order[k - 1]];
+}
+
+Numeric Selection::tournament(const std::vector<Numeric> &errors, const size_t &generation, const uint32_t &island, std::vector<size_t> &survivors)
+{
+    const auto &config = getConfig();
+    const auto n = errors.size();
+    const auto size = std::max<size_t>(1, config.SELECTION_TOURNAMENT_SIZE);
+
+    constexpr size_t BLOCK_SIZE = SELECTION_BLOCK_SIZE;
+    const size_t numBlocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    survivors.resize(n);
+    Numeric worst = 0;
+#pragma omp parallel for reduction(max : worst)
+    for (size_t b = 0; b < numBlocks; ++b)
+    {
+        RandomStream rng(RandomUse::SELECTION, generation, b, island);
+        const auto end = std::min(n, (b + 1) * BLOCK_SIZE);
+        for (size_t i = b * BLOCK_SIZE; i < end; ++i)
+        {
+            size_t winner = rng.below(n);
+            for (size_t t = 1; t < size; ++t)
+            {
+                const size_t entrant = rng.below(n);
+                if (better(errors, entrant, winner))
+                {
+                    winner = entrant;
+                }
+            }
+            survivors[i] = winner;
+            worst = std::max(worst, errors[winner]);
+        }
+    }
+
+    countParents(n, survivors);
+    return worst;
+}
+
+Numeric Selection::rank(const std::vector<Numeric> &errors, const size_t &generation, const uint32_t &island, std::vector<size_t> &survivors)
+{
+    const auto n = errors.size();
+    const auto k = best(n);
+    sortBest(errors, k);
+
+    // rank r of k is drawn with weight k - r; x = 1 - sqrt(1 - u) has
+    // density 2(1 - x) on [0, 1)
+    constexpr size_t BLOCK_SIZE = SELECTION_BLOCK_SIZE;
+    const size_t numBlocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    survivors.resize(n);
+#pragma omp parallel for
+    for (size_t b = 0; b < numBlocks; ++b)
+    {
+        RandomStream rng(RandomUse::SELECTION, generation, b, island);
+        const auto end = std::min(n, (b + 1) * BLOCK_SIZE);
+        for (size_t i = b * BLOCK_SIZE; i < end; ++i)
+        {
+            const auto x = 1 - std::sqrt(1 - rng.randf());
+            survivors[i] = m_order[std::min(k - 1, static_cast<size_t>(x * k))];
+        }
+    }
+
+    countParents(n, survivors);
+    return errors[m_order[k - 1]];
+}
+
+void Selection::fittest(const std::vector<Numeric> &errors, const size_t &k, std::vector<size_t> &out)
+{
+    if (k == 0)
+    {
+        out.clear();
+        return;
+    }
+    sortBest(errors, k);
+    out.assign(m_order.begin(), m_order.begin() + k);
+}
+
+void Selection::sortBest(const std::vector<Numeric> &errors, const size_t &k)
+{
+    partitionBest(errors, k);
+    std::sort(m_order.begin(), m_order.begin() + k, [&](const size_t &a, const size_t &b)
+              { return better(errors, a, b); });
+}
+
+void Selection::partitionBest(const std::vector<Numeric> &errors, const size_t &k)
+{
+    m_order.resize(errors.size());
+    std::iota(m_order.begin(), m_order.end(), 0);
+    std::nth_element(m_order.begin(), m_order.begin() + (k - 1), m_order.end(), [&](const size_t &a, const size_t &b)
+                     { return better(errors, a, b); });
+}
+
+size_t Selection::best(const size_t &n) const
+{
+    const auto &config = getConfig();
+    const auto k = static_cast<size_t>(std::llround(config.SELECTION_FRACTION * n));
+    return std::clamp<size_t>(k, 1, n);
+}
+
+void Selection::countParents(const size_t &n, const std::vector<size_t> &survivors)
+{
+    m_chosen.assign(n, 0);
+    for (const auto &s : survivors)
+    {
+        m_chosen[s] = 1;
+    }
+    m_parents = std::count(m_chosen.begin(), m_chosen.end(), 1);
+}
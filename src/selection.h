@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "config.h"
+
+// Selection
+//
+// Picks the parents of the next generation from the errors of this one,
+// which are computed once per generation; child i is bred from
+// survivors[i % survivors.size()]. Every strategy is O(n), or O(n + k log k)
+// for rank selection, and all but threshold selection always leave
+// survivors. Random choices are drawn from a stream per fixed block of
+// children, so a seed selects the same parents whatever the number of
+// threads.
+
+// selection runs over fixed blocks of agents, in parallel
+constexpr size_t SELECTION_BLOCK_SIZE = 4096;
+
+class Selection
+{
+public:
+    // fill survivors for generation of island from errors, whose extremes
+    // are minError and maxError; returns the error a survivor may have, at
+    // most
+    Numeric select(const std::vector<Numeric> &errors, const Numeric &minError, const Numeric &maxError, const size_t &generation, const uint32_t &island, std::vector<size_t> &survivors);
+
+    // the k best agents, best first
+    void fittest(const std::vector<Numeric> &errors, const size_t &k, std::vector<size_t> &out);
+
+    // the number of distinct parents of the last selection
+    size_t parents() const { return m_parents; }
+
+private:
+    // threshold: the agents whose error is below a threshold near the
+    // minimum, in index order; blocks of agents are counted, then listed
+    Numeric threshold(const std::vector<Numeric> &errors, const Numeric &minError, const Numeric &maxError, std::vector<size_t> &survivors);
+
+    // top-k: the k best agents, found with nth_element
+    Numeric topK(const std::vector<Numeric> &errors, std::vector<size_t> &survivors);
+
+    // tournament: each child's parent is the best of a few agents drawn at
+    // random
+    Numeric tournament(const std::vector<Numeric> &errors, const size_t &generation, const uint32_t &island, std::vector<size_t> &survivors);
+
+    // rank: each child's parent is drawn from the k best agents, weighted
+    // linearly by rank
+    Numeric rank(const std::vector<Numeric> &errors, const size_t &generation, const uint32_t &island, std::vector<size_t> &survivors);
+
+    // the k best agents into the front of m_order, the worst of them last
+    void partitionBest(const std::vector<Numeric> &errors, const size_t &k);
+
+    // the same, in order, best first
+    void sortBest(const std::vector<Numeric> &errors, const size_t &k);
+
+    // k for top-k and rank selection
+    size_t best(const size_t &n) const;
+
+    // count the distinct agents among survivors
+    void countParents(const size_t &n, const std::vector<size_t> &survivors);
+
+    std::vector<size_t> m_counts;
+    std::vector<size_t> m_order;
+    std::vector<uint8_t> m_chosen;
+    size_t m_parents = 0;
+};
@@ -1,113 +1,169 @@
 #pragma once
 
-#include <unordered_map>
-
 #include "neuron.h"
 
-class SummingSink : public Neuron
-{
-public:
-    virtual void write(const Numeric &weight)
-    {
-        m_weight += weight;
-    }
-
-    virtual void reset()
-    {
-        m_weight = 0;
-        m_applied = false;
-    }
-
-    virtual void apply(Agent::SP a)
-    {
-        if (!m_applied)
-        {
-            m_weight = sigmoid(m_weight);
-            _apply(a);
-            m_applied = true;
-        }
-    }
-    virtual void _apply(Agent::SP a) = 0;
-
-protected:
-    Numeric m_weight;
-    bool m_applied;
-};
+// Sinks accumulate into their slot of the brain's value array during an
+// update, and are then activated and applied once each, in order
 
-class Sink_Velocity : public SummingSink
+enum class SinkKind : uint8_t
 {
-public:
-    virtual void _apply(Agent::SP a)
-    {
-        a->velocity(a->velocity() + m_weight);
-    };
+    ANGULAR_VELOCITY,
+    DIRECTION,
+    VELOCITY,
+    MOVE,
+    RED,
+    GREEN,
+    BLUE,
+    SIZE,
 };
 
-class Sink_Move : public SummingSink
-{
-public:
-    virtual void _apply(Agent::SP a)
-    {
-        a->move(m_weight * a->velocity());
-    };
-};
+constexpr NeuronNames<SinkKind, 8> SINK_NAMES{{
+    {"angular-velocity", SinkKind::ANGULAR_VELOCITY},
+    {"direction", SinkKind::DIRECTION},
+    {"velocity", SinkKind::VELOCITY},
+    {"move", SinkKind::MOVE},
+    {"red", SinkKind::RED},
+    {"green", SinkKind::GREEN},
+    {"blue", SinkKind::BLUE},
+    {"size", SinkKind::SIZE},
+}};
 
-class Sink_Angular_Velocity : public SummingSink
+constexpr std::optional<SinkKind> findSink(const std::string_view &name)
 {
-public:
-    virtual void _apply(Agent::SP a)
-    {
-        a->angular_vel(a->angular_vel() + m_weight);
-    };
-};
+    return findNeuron(SINK_NAMES, name);
+}
 
-class Sink_Direction : public SummingSink
+// apply a sink value already passed through the sigmoid
+inline void applySink(const SinkKind &kind, Agent &a, const Numeric &activated)
 {
-public:
-    virtual void _apply(Agent::SP a)
+    switch (kind)
     {
-        a->direction(a->direction() + (a->angular_vel() * m_weight));
-    };
-};
+    case SinkKind::ANGULAR_VELOCITY:
+        a.angular_vel(a.angular_vel() + activated);
+        break;
+    case SinkKind::DIRECTION:
+        a.direction(a.direction() + (a.angular_vel() * activated));
+        break;
+    case SinkKind::VELOCITY:
+        a.velocity(a.velocity() + activated);
+        break;
+    case SinkKind::MOVE:
+        a.move(activated * a.velocity());
+        break;
+    case SinkKind::RED:
+        a.colour().r = std::abs(255 * activated);
+        break;
+    case SinkKind::GREEN:
+        a.colour().g = std::abs(255 * activated);
+        break;
+    case SinkKind::BLUE:
+        a.colour().b = std::abs(255 * activated);
+        break;
+    case SinkKind::SIZE:
+        a.size(std::abs((getConfig().MAX_SIZE * activated)));
+        break;
+    }
+}
 
-class Sink_Red : public SummingSink
+// apply a sink to every lane of a lane group, as applySink
+inline void applySink(const SinkKind &kind, AgentLanes &a, const Numeric *activated)
 {
-public:
-    virtual void _apply(Agent::SP a)
+    switch (kind)
     {
-        auto &c = a->colour();
-        c.r = std::abs(255 * m_weight);
-    };
-};
+    case SinkKind::ANGULAR_VELOCITY:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            a.angular_vel(l, a.angular_vel(l) + activated[l]);
+        }
+        break;
+    case SinkKind::DIRECTION:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            a.direction(l, a.direction(l) + (a.angular_vel(l) * activated[l]));
+        }
+        break;
+    case SinkKind::VELOCITY:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            a.velocity(l, a.velocity(l) + activated[l]);
+        }
+        break;
+    case SinkKind::MOVE:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            a.move(l, activated[l] * a.velocity(l));
+        }
+        break;
+    case SinkKind::RED:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            a.red(l) = std::abs(255 * activated[l]);
+        }
+        break;
+    case SinkKind::GREEN:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            a.green(l) = std::abs(255 * activated[l]);
+        }
+        break;
+    case SinkKind::BLUE:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            a.blue(l) = std::abs(255 * activated[l]);
+        }
+        break;
+    case SinkKind::SIZE:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            a.size(l, std::abs((getConfig().MAX_SIZE * activated[l])));
+        }
+        break;
+    }
+}
 
-class Sink_Green : public SummingSink
-{
-public:
-    virtual void _apply(Agent::SP a)
-    {
-        auto &c = a->colour();
-        c.g = std::abs(255 * m_weight);
-    };
-};
+// the agent state a sink reads and writes when it is applied
 
-class Sink_Blue : public SummingSink
+constexpr AgentFields sinkReads(const SinkKind &kind)
 {
-public:
-    virtual void _apply(Agent::SP a)
+    switch (kind)
     {
-        auto &c = a->colour();
-        c.b = std::abs(255 * m_weight);
-    };
-};
+    case SinkKind::ANGULAR_VELOCITY:
+        return FIELD_ANGULAR_VELOCITY;
+    case SinkKind::DIRECTION:
+        return FIELD_ANGULAR_VELOCITY | FIELD_DIRECTION;
+    case SinkKind::VELOCITY:
+        return FIELD_VELOCITY;
+    case SinkKind::MOVE:
+        return FIELD_VELOCITY | FIELD_DIRECTION | FIELD_POSITION;
+    case SinkKind::RED:
+    case SinkKind::GREEN:
+    case SinkKind::BLUE:
+    case SinkKind::SIZE:
+        break;
+    }
+    return 0;
+}
 
-class Sink_Size : public SummingSink
+constexpr AgentFields sinkWrites(const SinkKind &kind)
 {
-public:
-    virtual void _apply(Agent::SP a)
+    switch (kind)
     {
-        const auto &config = getConfig();
-        a->size(std::abs((config.MAX_SIZE * m_weight)));
-    };
-};
-
-const NeuronRegistry &getSinks();
+    case SinkKind::ANGULAR_VELOCITY:
+        return FIELD_ANGULAR_VELOCITY;
+    case SinkKind::DIRECTION:
+        return FIELD_DIRECTION;
+    case SinkKind::VELOCITY:
+        return FIELD_VELOCITY;
+    case SinkKind::MOVE:
+        return FIELD_POSITION;
+    case SinkKind::RED:
+        return FIELD_COLOUR_R;
+    case SinkKind::GREEN:
+        return FIELD_COLOUR_G;
+    case SinkKind::BLUE:
+        return FIELD_COLOUR_B;
+    case SinkKind::SIZE:
+        return FIELD_SIZE;
+    }
+    return 0;
+}
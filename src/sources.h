@@ -1,131 +1,199 @@
 #pragma once
 
+#include <algorithm>
+
 #include "neuron.h"
 #include "conditions.h"
 
-class Source_Age : public Neuron
-{
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        const auto &config = getConfig();
-        return static_cast<Numeric>(a->age()) / config.GEN_ITERS;
-    };
-};
-
-class Source_Velocity : public Neuron
-{
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        const auto &config = getConfig();
-        return a->velocity() / config.MAX_VELOCITY;
-    };
-};
-
-class Source_West : public Neuron
-{
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        const auto &config = getConfig();
-        return (config.SCREEN_WIDTH - a->position().x) / config.SCREEN_WIDTH;
-    };
-};
-
-class Source_East : public Neuron
-{
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        const auto &config = getConfig();
-        return 1 - ((config.SCREEN_WIDTH - a->position().x) / config.SCREEN_WIDTH);
-    };
-};
-
-class Source_North : public Neuron
-{
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        const auto &config = getConfig();
-        return (config.SCREEN_HEIGHT - a->position().y) / config.SCREEN_HEIGHT;
-    };
-};
+// Sources are sampled once per tick by the agent's sensing stage, into the
+// source part of the brain's value array; connections then read the sample.
 
-class Source_South : public Neuron
+enum class SourceKind : uint8_t
 {
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        const auto &config = getConfig();
-        return 1 - ((config.SCREEN_HEIGHT - a->position().y) / config.SCREEN_HEIGHT);
-    };
+    AGE,
+    DIRECTION,
+    WEST,
+    EAST,
+    NORTH,
+    SOUTH,
+    ANGULAR_VELOCITY,
+    VELOCITY,
+    ERROR,
+    RED,
+    GREEN,
+    BLUE,
+    SIZE,
 };
 
-class Source_Angular_Velocity : public Neuron
-{
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        const auto &config = getConfig();
-        return a->angular_vel() / config.MAX_ANGULAR_VELOCITY;
-    };
-};
+constexpr NeuronNames<SourceKind, 13> SOURCE_NAMES{{
+    {"age", SourceKind::AGE},
+    {"direction", SourceKind::DIRECTION},
+    {"west", SourceKind::WEST},
+    {"east", SourceKind::EAST},
+    {"north", SourceKind::NORTH},
+    {"south", SourceKind::SOUTH},
+    {"angular-velocity", SourceKind::ANGULAR_VELOCITY},
+    {"velocity", SourceKind::VELOCITY},
+    {"error", SourceKind::ERROR},
+    {"red", SourceKind::RED},
+    {"green", SourceKind::GREEN},
+    {"blue", SourceKind::BLUE},
+    {"size", SourceKind::SIZE},
+}};
 
-class Source_Direction : public Neuron
+constexpr std::optional<SourceKind> findSource(const std::string_view &name)
 {
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        return a->direction() / TWOPI;
-    };
-};
+    return findNeuron(SOURCE_NAMES, name);
+}
 
-class Source_Error : public Neuron
+inline const Numeric senseSource(const SourceKind &kind, Agent &a)
 {
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
+    const auto &config = getConfig();
+    switch (kind)
     {
+    case SourceKind::AGE:
+        return static_cast<Numeric>(a.age()) / config.GEN_ITERS;
+    case SourceKind::DIRECTION:
+        return a.direction() / TWOPI;
+    case SourceKind::WEST:
+        return (config.SCREEN_WIDTH - a.position().x) / config.SCREEN_WIDTH;
+    case SourceKind::EAST:
+        return 1 - ((config.SCREEN_WIDTH - a.position().x) / config.SCREEN_WIDTH);
+    case SourceKind::NORTH:
+        return (config.SCREEN_HEIGHT - a.position().y) / config.SCREEN_HEIGHT;
+    case SourceKind::SOUTH:
+        return 1 - ((config.SCREEN_HEIGHT - a.position().y) / config.SCREEN_HEIGHT);
+    case SourceKind::ANGULAR_VELOCITY:
+        return a.angular_vel() / config.MAX_ANGULAR_VELOCITY;
+    case SourceKind::VELOCITY:
+        return a.velocity() / config.MAX_VELOCITY;
+    case SourceKind::ERROR:
         return ErrorFunction(a);
-    };
-};
+    case SourceKind::RED:
+        return a.colour().r / 255.0;
+    case SourceKind::GREEN:
+        return a.colour().g / 255.0;
+    case SourceKind::BLUE:
+        return a.colour().b / 255.0;
+    case SourceKind::SIZE:
+        return a.size() / config.MAX_SIZE;
+    }
+    return 0;
+}
 
-class Source_Red : public Neuron
+// sense a source for every lane of a lane group, as senseSource; every
+// agent of the group is age ticks old
+inline void senseSource(const SourceKind &kind, const AgentLanes &a, const size_t &age, Numeric *out)
 {
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
+    const auto &config = getConfig();
+    switch (kind)
     {
-        return a->colour().r / 255.0;
-    };
-};
+    case SourceKind::AGE:
+        std::fill(out, out + LANES, static_cast<Numeric>(age) / config.GEN_ITERS);
+        break;
+    case SourceKind::DIRECTION:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = a.direction(l) / TWOPI;
+        }
+        break;
+    case SourceKind::WEST:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = (config.SCREEN_WIDTH - a.position(l).x) / config.SCREEN_WIDTH;
+        }
+        break;
+    case SourceKind::EAST:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = 1 - ((config.SCREEN_WIDTH - a.position(l).x) / config.SCREEN_WIDTH);
+        }
+        break;
+    case SourceKind::NORTH:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = (config.SCREEN_HEIGHT - a.position(l).y) / config.SCREEN_HEIGHT;
+        }
+        break;
+    case SourceKind::SOUTH:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = 1 - ((config.SCREEN_HEIGHT - a.position(l).y) / config.SCREEN_HEIGHT);
+        }
+        break;
+    case SourceKind::ANGULAR_VELOCITY:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = a.angular_vel(l) / config.MAX_ANGULAR_VELOCITY;
+        }
+        break;
+    case SourceKind::VELOCITY:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = a.velocity(l) / config.MAX_VELOCITY;
+        }
+        break;
+    case SourceKind::ERROR:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = ErrorFunction(a.position(l));
+        }
+        break;
+    case SourceKind::RED:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = a.red(l) / 255.0;
+        }
+        break;
+    case SourceKind::GREEN:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = a.green(l) / 255.0;
+        }
+        break;
+    case SourceKind::BLUE:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = a.blue(l) / 255.0;
+        }
+        break;
+    case SourceKind::SIZE:
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            out[l] = a.size(l) / config.MAX_SIZE;
+        }
+        break;
+    }
+}
 
-class Source_Green : public Neuron
+// the agent state a source senses
+constexpr AgentFields sourceReads(const SourceKind &kind)
 {
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
+    switch (kind)
     {
-        return a->colour().g / 255.0;
-    };
-};
-
-class Source_Blue : public Neuron
-{
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        return a->colour().b / 255.0;
-    };
-};
-
-class Source_Size : public Neuron
-{
-public:
-    virtual const Numeric read(Agent::SP a, const Numeric &weight)
-    {
-        const auto &config = getConfig();
-        return a->size() / config.MAX_SIZE;
-    };
-};
-
-const NeuronRegistry &getSources();
+    case SourceKind::AGE:
+        return FIELD_AGE;
+    case SourceKind::DIRECTION:
+        return FIELD_DIRECTION;
+    case SourceKind::WEST:
+    case SourceKind::EAST:
+    case SourceKind::NORTH:
+    case SourceKind::SOUTH:
+        return FIELD_POSITION;
+    case SourceKind::ANGULAR_VELOCITY:
+        return FIELD_ANGULAR_VELOCITY;
+    case SourceKind::VELOCITY:
+        return FIELD_VELOCITY;
+    case SourceKind::ERROR:
+        return ERROR_FUNCTION_READS;
+    case SourceKind::RED:
+        return FIELD_COLOUR_R;
+    case SourceKind::GREEN:
+        return FIELD_COLOUR_G;
+    case SourceKind::BLUE:
+        return FIELD_COLOUR_B;
+    case SourceKind::SIZE:
+        return FIELD_SIZE;
+    }
+    return 0;
+}
@@ -265,17 +265,26 @@ void CleanupSDL()
     SDL_Quit();
 }
 
-int Render(std::vector<Agent::SP> agents, const size_t &generation, const size_t &iter, const int &frame, const Numeric &time, const PopulationStats &stats)
+// whether Render draws this iteration of this generation
+bool Rendered(const size_t &generation, const size_t &iter)
 {
     const auto &config = getConfig();
 
     // render only end frame for most generations
     if (config.REALTIME_EVERY_NGENS == 0 || (generation % config.REALTIME_EVERY_NGENS != 0))
     {
-        if (iter != (config.GEN_ITERS - 1))
-        {
-            return 0;
-        }
+        return iter == (config.GEN_ITERS - 1);
+    }
+    return true;
+}
+
+int Render(const PopulationStore &store, const size_t &generation, const size_t &iter, const int &frame, const Numeric &time, const PopulationStats &stats)
+{
+    const auto &config = getConfig();
+
+    if (!Rendered(generation, iter))
+    {
+        return 0;
     }
 
     // reset background
@@ -291,19 +300,19 @@ int Render(std::vector<Agent::SP> agents, const size_t &generation, const size_t
     {
         const auto offsx = (uiconfig.winWidth - (config.SCREEN_WIDTH * config.ZOOM)) / 2.0;
         const auto offsy = (uiconfig.winHeight - (config.SCREEN_HEIGHT * config.ZOOM)) / 2.0;
-        for (const auto entity : agents)
+        for (size_t i = 0; i < store.count(); ++i)
         {
-            const auto &col = entity->colour();
+            const auto &col = store.colour[i];
 
-            const auto error = ErrorFunction(entity);
-            Uint8 alpha = std::min(255.0, std::max(5.0, 5 + (250 * (1 - error))));
+            const Position pos{store.x[i], store.y[i]};
+            const auto error = ErrorFunction(pos);
+            Uint8 alpha = std::min<Numeric>(255, std::max<Numeric>(5, 5 + (250 * (1 - error))));
             if (error < stats.errThreshold)
             {
                 living++;
             }
 
-            const auto &pos = entity->position();
-            const auto &sz = entity->size();
+            const auto &sz = store.size[i];
             filledCircleRGBA(uiconfig.render, offsx + (pos.x * config.ZOOM), offsy + (pos.y * config.ZOOM), sz * config.ZOOM, col.r, col.g, col.b, alpha);
         };
     }
@@ -319,7 +328,7 @@ int Render(std::vector<Agent::SP> agents, const size_t &generation, const size_t
             << "   i= " << (iter + 1)
             << "   f= " << (frame + 1)
             << "   t= " << std::setw(5) << time
-            << "   p= " << agents.size()
+            << "   p= " << store.count()
             << "   sc= " << living
             << "   st= " << std::setw(5) << stats.survivors
             << "   Emn= " << std::setw(5) << stats.minError
@@ -46,4 +46,5 @@ std::string FindFont();
 int InitSDL();
 int ProcessEvents();
 void CleanupSDL();
-int Render(std::vector<Agent::SP> agents, const size_t &generation, const size_t &iter, const int &frame, const Numeric &time, const PopulationStats &stats);
+bool Rendered(const size_t &generation, const size_t &iter);
+int Render(const PopulationStore &store, const size_t &generation, const size_t &iter, const int &frame, const Numeric &time, const PopulationStats &stats);